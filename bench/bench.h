@@ -0,0 +1,25 @@
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include <chrono>
+#include <iostream>
+
+using namespace std;
+
+// Runs fn once to warm up, then `iterations` more times, and returns the mean
+// wall time per item in nanoseconds.
+template <class F> double time_ns(int iterations, size_t items, F fn)
+{
+  fn();
+  auto start = chrono::steady_clock::now();
+  for (auto i = 0; i < iterations; i++) fn();
+  auto elapsed = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+  return elapsed / (double(iterations) * items);
+}
+
+inline void report(const char *name, double value, const char *unit = "ns/item")
+{
+  cout << "  " << name << ": " << value << " " << unit << endl;
+}
+
+#endif //__BENCH_H__
@@ -0,0 +1,60 @@
+// Depth-only rasterization against the colour pass it shares a loop with.
+#include <limits>
+#include <vector>
+#include "bench.h"
+#include "model.h"
+#include "render.h"
+#include "tgaimage.h"
+
+using namespace std;
+
+int main(int argc, char** argv)
+{
+  const int iterations = 50;
+  vector<string> files{"obj/african_head.obj", "obj/diablo3_pose.obj"};
+  if (argc > 1) files.assign(argv + 1, argv + argc);
+  auto light_dir = normalize(vec3(1, -1, -1.5));
+
+  for (auto &file : files) {
+    Model model(file);
+    if (model.nfaces() == 0) continue;
+    cout << file << ": " << model.nfaces() << " faces" << endl;
+
+    for (auto size : {800, 2048}) {
+      TGAImage image(size, size, TGAImage::RGB);
+      vector<float> zbuffer(size * size);
+      vector<vec3> screen(model.nfaces() * 3);
+      for (auto i = 0; i < model.nfaces(); i++) {
+        auto face = model.face(i);
+        for (auto j = 0; j < 3; j++) {
+          screen[i * 3 + j] = world2screen(model.vert(face[j]), size, size);
+        }
+      }
+      auto pass = [&](bool depth_only) {
+        fill(zbuffer.begin(), zbuffer.end(), -numeric_limits<float>::max());
+        for (auto i = 0; i < model.nfaces(); i++) {
+          if (depth_only) {
+            triangle_depth(&screen[i * 3], zbuffer, size, size);
+          } else {
+            triangle(&screen[i * 3], zbuffer, image, TGAColor(255, 0, 0, 255));
+          }
+        }
+      };
+      cout << " " << size << "x" << size << endl;
+      report("triangle()", time_ns(iterations, 1, [&] { pass(false); }) / 1e6, "ms/pass");
+      report("triangle_depth()", time_ns(iterations, 1, [&] { pass(true); }) / 1e6, "ms/pass");
+    }
+
+    TGAImage image(800, 800, TGAImage::RGB);
+    ShadowMap shadow(2048, light_dir);
+    cout << " shadowed frame, 800x800 with a 2048 map" << endl;
+    report("shadow map render", time_ns(iterations, 1, [&] { shadow.render(model); }) / 1e6, "ms");
+    report("main pass with PCF", time_ns(iterations, 1, [&] {
+      draw_model(model, image, TGAColor(255, 0, 0, 255), light_dir, &shadow);
+    }) / 1e6, "ms");
+    report("main pass, no shadows", time_ns(iterations, 1, [&] {
+      draw_model(model, image, TGAColor(255, 0, 0, 255), light_dir);
+    }) / 1e6, "ms");
+  }
+  return 0;
+}
@@ -0,0 +1,38 @@
+// Encode time and file size of the default render as RLE TGA, QOI and PNG
+// at several deflate levels and thread counts.
+#include <string>
+#include <vector>
+#include "bench.h"
+#include "model.h"
+#include "png.h"
+#include "qoi.h"
+#include "render.h"
+#include "tgaimage.h"
+
+using namespace std;
+
+int main(int argc, char** argv)
+{
+  const int size = 800;
+  const int iterations = 20;
+  Model model(argc > 1 ? argv[1] : "obj/african_head.obj");
+  TGAImage image(size, size, TGAImage::RGB);
+  draw_model(model, image, TGAColor(255, 0, 0, 255), vec3(0, 0, -1));
+  image.flip_vertically();
+
+  vector<unsigned char> bytes;
+  auto row = [&](const string &name, double ns) {
+    cout << "  " << name << ns / 1e6 << " ms, " << bytes.size() << " bytes, "
+         << size * size * 3 / (ns / 1e9) / 1e6 << " MB/s" << endl;
+  };
+  cout << size << "x" << size << " RGB, " << size * size * 3 << " bytes raw" << endl;
+  row("TGA, RLE:          ", time_ns(iterations, 1, [&] { image.encode_tga(bytes); }));
+  row("QOI:               ", time_ns(iterations, 1, [&] { encode_qoi(image, bytes); }));
+  for (auto level : {0, 1, 2, 6, 9}) {
+    for (auto nthreads : {1, 4}) {
+      auto ns = time_ns(iterations, 1, [&] { encode_png(image, bytes, level, nthreads); });
+      row("PNG, level " + to_string(level) + ", " + to_string(nthreads) + " thr: ", ns);
+    }
+  }
+  return 0;
+}
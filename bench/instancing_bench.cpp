@@ -0,0 +1,103 @@
+// A crowd of 16k heads: draw_instance() one by one against the BVH-culled,
+// binned InstancedRenderer.
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+#include "bench.h"
+#include "instancing.h"
+#include "model.h"
+#include "render.h"
+#include "tgaimage.h"
+
+using namespace std;
+
+int main(int argc, char** argv)
+{
+  const int size = 1024;
+  const int count = 16384;
+  const int iterations = 5;
+  Model model(argc > 1 ? argv[1] : "obj/african_head.obj");
+  model.build_lods(8);
+  auto light_dir = vec3(0, 0, -1);
+
+  // Random placement in a slab a little wider than the view, random turn
+  // about y. The projection is orthographic, so fake perspective by scaling
+  // with depth: a few large heads in front of many small ones.
+  mt19937 rng(1);
+  uniform_real_distribution<float> pos(-1.1f, 1.1f), depth(0, 1), angle(-.6f, .6f);
+  vector<Instance> instances(count);
+  for (auto &instance : instances) {
+    auto t = depth(rng), a = angle(rng);
+    auto s = .015f + .085f * t * t * t;
+    auto &m = instance.transform = mat4::identity();
+    m[0][0] = s * cos(a); m[0][2] = s * sin(a);
+    m[1][1] = s;
+    m[2][0] = -s * sin(a); m[2][2] = s * cos(a);
+    m[0][3] = pos(rng);
+    m[1][3] = pos(rng);
+    m[2][3] = t * 1.8f - .9f;
+    instance.color = TGAColor(128 + rng() % 128, 128 + rng() % 128, 128 + rng() % 128, 255);
+  }
+  cout << count << " instances, " << size << "x" << size << endl;
+
+  TGAImage reference(size, size, TGAImage::RGB);
+  vector<float> zbuffer(size * size);
+  auto triangles = 0;
+  auto ns = time_ns(iterations, 1, [&] {
+    fill(zbuffer.begin(), zbuffer.end(), -numeric_limits<float>::max());
+    reference.clear();
+    triangles = 0;
+    for (auto &instance : instances) {
+      triangles += draw_instance(model, instance.transform, reference, zbuffer, instance.color, light_dir);
+    }
+  });
+  cout << "  draw_instance, LOD only:  " << ns / 1e6 << " ms/frame, " << triangles << " triangles" << endl;
+
+  TGAImage image(size, size, TGAImage::RGB);
+  InstancedRenderer renderer(size, size);
+  auto run = [&](const char *name, bool rebuild, int nthreads, bool jitter) {
+    InstanceStats stats;
+    normal_distribution<float> step(0, .002f);
+    auto ns = time_ns(iterations, 1, [&] {
+      if (jitter) {
+        for (auto &instance : instances) {
+          instance.transform[0][3] += step(rng);
+          instance.transform[1][3] += step(rng);
+        }
+      }
+      stats = renderer.render(model, instances, image, light_dir, rebuild, nthreads);
+    });
+    cout << "  " << name << ns / 1e6 << " ms/frame, " << stats.triangles << " triangles, "
+         << stats.frustum_culled << " frustum / " << stats.occlusion_culled << " occlusion culled, "
+         << stats.occluders << " occluders, " << stats.nodes_visited << " nodes visited" << endl;
+  };
+
+  auto budget = renderer.occluder_budget;
+  auto min_size = renderer.min_occluder_size;
+  renderer.occluder_budget = count;
+  renderer.min_occluder_size = 0;
+  run("every instance occludes:  ", false, 0, false);
+  renderer.occluder_budget = 256;
+  renderer.min_occluder_size = 64;
+  run("256 large occluders:      ", false, 0, false);
+  renderer.occluder_budget = budget;
+  renderer.min_occluder_size = min_size;
+  run("defaults (frustum only):  ", false, 0, false);
+
+  // Same scene as the reference, so only depth ties should differ.
+  auto differing = 0;
+  for (auto i = 0; i < size * size * 3; i++) {
+    differing += reference.buffer()[i] != image.buffer()[i];
+  }
+  cout << "  bytes differing from draw_instance: " << differing << endl;
+
+  for (auto nthreads : {1, 2, 4}) {
+    string name = "  " + to_string(nthreads) + " thread(s):             ";
+    run(name.c_str(), false, nthreads, false);
+  }
+  run("moving, refit each frame: ", false, 0, true);
+  run("moving, rebuild each frame:", true, 0, true);
+  return 0;
+}
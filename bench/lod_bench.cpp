@@ -0,0 +1,55 @@
+// Crowd scenes of small instances, full detail against automatic LOD.
+#include <limits>
+#include <vector>
+#include "bench.h"
+#include "model.h"
+#include "render.h"
+#include "tgaimage.h"
+
+using namespace std;
+
+int main(int argc, char** argv)
+{
+  const int size = 800;
+  const int iterations = 10;
+  Model model(argc > 1 ? argv[1] : "obj/african_head.obj");
+  auto light_dir = vec3(0, 0, -1);
+
+  auto start = chrono::steady_clock::now();
+  model.build_lods();
+  chrono::duration<double, milli> build = chrono::steady_clock::now() - start;
+  cout << "LOD chain built in " << build.count() << " ms:";
+  for (auto i = 0; i < model.nlods(); i++) cout << " " << model.lod(i).nfaces();
+  cout << " faces" << endl;
+
+  TGAImage image(size, size, TGAImage::RGB);
+  vector<float> zbuffer(size * size);
+  for (auto grid : {4, 8, 16, 32, 64}) {
+    vector<mat4> placements;
+    auto step = 2.f / grid;
+    for (auto j = 0; j < grid; j++) {
+      for (auto i = 0; i < grid; i++) {
+        auto m = mat4::identity();
+        m[0][0] = m[1][1] = m[2][2] = step / 2;
+        m[0][3] = -1 + step * (i + .5f);
+        m[1][3] = -1 + step * (j + .5f);
+        placements.push_back(m);
+      }
+    }
+    cout << grid * grid << " instances, ~" << int(size / grid) << " px each" << endl;
+    for (auto use_lod : {false, true}) {
+      auto triangles = 0;
+      auto ns = time_ns(iterations, 1, [&] {
+        fill(zbuffer.begin(), zbuffer.end(), -numeric_limits<float>::max());
+        image.clear();
+        triangles = 0;
+        for (auto &m : placements) {
+          triangles += draw_instance(model, m, image, zbuffer, TGAColor(255, 0, 0, 255), light_dir, use_lod);
+        }
+      });
+      cout << "  " << (use_lod ? "LOD:        " : "full detail: ") << ns / 1e6 << " ms/frame, "
+           << triangles << " triangles rasterized" << endl;
+    }
+  }
+  return 0;
+}
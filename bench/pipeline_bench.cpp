@@ -0,0 +1,49 @@
+// A 24-frame turntable alternating the two bundled models: every stage in
+// order on one thread against the threaded pipeline at a few queue depths,
+// with io_uring and with the writer-thread fallback.
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "bench.h"
+#include "pipeline.h"
+
+using namespace std;
+
+int main(int argc, char** argv)
+{
+  const int frames = 24;
+  const int size = 800;
+  vector<FrameJob> jobs;
+  for (auto i = 0; i < frames; i++) {
+    auto angle = 2 * float(M_PI) * i / frames;
+    auto m = mat4::identity();
+    m[0][0] = m[2][2] = cos(angle);
+    m[0][2] = sin(angle);
+    m[2][0] = -sin(angle);
+    char name[48];
+    snprintf(name, sizeof(name), "bench_frame_%03d.tga", i);
+    jobs.push_back(FrameJob{i % 2 ? "obj/diablo3_pose.obj" : "obj/african_head.obj", m,
+                            TGAColor(255, 0, 0, 255), name});
+  }
+
+  auto run = [&](const string &name, int depth, bool use_io_uring) {
+    auto stats = render_frames(jobs, size, size, vec3(0, 0, -1), depth, use_io_uring);
+    auto pct = [&](double seconds) { return int(100 * seconds / stats.seconds + .5); };
+    cout << "  " << name << stats.frames / stats.seconds << " frames/s; busy load " << pct(stats.load.busy)
+         << "% render " << pct(stats.render.busy) << "% encode " << pct(stats.write.busy) << "%, writes in flight "
+         << pct(stats.io_seconds) << "%; render starved " << pct(stats.render.starved) << "% blocked "
+         << pct(stats.render.blocked) << "%" << (stats.failures ? " (write failures)" : "") << endl;
+  };
+
+  cout << frames << " frames, " << size << "x" << size << endl;
+  run("serial:                 ", 0, false);
+  for (auto depth : {1, 2, 4}) {
+    run("depth " + to_string(depth) + ", io_uring:      ", depth, true);
+    run("depth " + to_string(depth) + ", writer thread: ", depth, false);
+  }
+  for (auto &job : jobs) {
+    remove(job.output.c_str());
+  }
+  return 0;
+}
@@ -0,0 +1,59 @@
+// Update latency of RenderSession edits against a full re-render.
+#include <vector>
+#include "bench.h"
+#include "model.h"
+#include "session.h"
+
+using namespace std;
+
+mat4 placement(float x, float y, float scale)
+{
+  auto m = mat4::identity();
+  m[0][0] = m[1][1] = m[2][2] = scale;
+  m[0][3] = x;
+  m[1][3] = y;
+  return m;
+}
+
+int main(int argc, char** argv)
+{
+  const int iterations = 50;
+  const int grid = 4;
+  Model model(argc > 1 ? argv[1] : "obj/african_head.obj");
+  RenderSession session(800, 800);
+  for (auto j = 0; j < grid; j++) {
+    for (auto i = 0; i < grid; i++) {
+      auto step = 2.f / grid;
+      session.add_object(model, placement(-1 + step * (i + .5f), -1 + step * (j + .5f), step / 2),
+                         TGAColor(255, 0, 0, 255));
+    }
+  }
+  session.render();
+  cout << grid * grid << " objects, " << grid * grid * model.nfaces() << " triangles, 800x800" << endl;
+
+  auto measure = [&](const char *name, auto edit) {
+    SessionStats stats{};
+    auto ns = time_ns(iterations, 1, [&] {
+      edit();
+      stats = session.render();
+    });
+    cout << "  " << name << ": " << ns / 1e6 << " ms (" << stats.tiles_rasterized << " tiles, "
+         << stats.triangles_rasterized << " triangles rasterized, " << stats.pixels_shaded << " pixels shaded)" << endl;
+  };
+
+  measure("full re-render", [&] { session.invalidate(); });
+  auto light = 0;
+  measure("light change", [&] {
+    session.set_light(normalize(vec3(light++ % 2 ? .5f : -.5f, 0, -1)));
+  });
+  auto color = 0;
+  measure("material change", [&] {
+    session.set_color(5, color++ % 2 ? TGAColor(0, 255, 0, 255) : TGAColor(255, 0, 0, 255));
+  });
+  auto frame = 0;
+  measure("one object moves", [&] {
+    auto dx = (frame++ % 2) * .02f;
+    session.set_transform(5, placement(-1 + .75f + dx, -1 + .75f, .25f));
+  });
+  return 0;
+}
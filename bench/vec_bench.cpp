@@ -0,0 +1,226 @@
+// Microbenchmarks for vec.h against the double-precision Vec3 it replaced.
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include "bench.h"
+#include "model.h"
+#include "vec.h"
+
+using namespace std;
+
+namespace legacy {
+
+// The pre-rewrite Vec3, kept verbatim (minus unused members) for comparison.
+template <class T> class Vec3 {
+  public:
+    T x, y, z;
+
+    Vec3() { x = y = z = 0; };
+
+    Vec3(T x_, T y_, T z_)
+    {
+      x = x_;
+      y = y_;
+      z = z_;
+    }
+
+    constexpr T length()
+    {
+      return sqrt(x * x + y * y + z * z);
+    }
+
+    T normalize()
+    {
+      auto l = length();
+      x /= l;
+      y /= l;
+      z /= l;
+      return l;
+    }
+
+    constexpr Vec3<T> operator -(const Vec3<T> &v)
+    {
+      return Vec3<T>(x - v.x, y - v.y, z - v.z);
+    }
+
+    constexpr Vec3<T> operator ^(const Vec3<T> &v)
+    {
+      return Vec3<T>(
+          y * v.z - z * v.y,
+          z * v.x - x * v.z,
+          x * v.y - y * v.x);
+    }
+
+    constexpr T operator *(const Vec3<T> &v)
+    {
+      return x * v.x + y * v.y + z * v.z;
+    }
+
+    constexpr T operator [](const int &i)
+    {
+      if (i == 0) return x;
+      else if (i == 1) return y;
+      else return z;
+    }
+};
+
+typedef Vec3<double> vec3;
+
+static vec3 barycentric(vec3 A, vec3 B, vec3 C, vec3 P) {
+    vec3 s[2];
+    for (int i=2; i--; ) {
+        s[i].x = C[i]-A[i];
+        s[i].y = B[i]-A[i];
+        s[i].z = A[i]-P[i];
+    }
+    vec3 u = s[0] ^ s[1];
+    if (abs(u[2]) > 1e-2) {
+        return vec3(1.f-(u.x+u.y)/u.z, u.y/u.z, u.x/u.z);
+    }
+    return vec3(-1,1,1);
+}
+
+} // namespace legacy
+
+static vec3 barycentric(vec3 A, vec3 B, vec3 C, vec3 P) {
+  vec3 s[2];
+  for (int i = 2; i--; ) {
+    s[i].x = C[i] - A[i];
+    s[i].y = B[i] - A[i];
+    s[i].z = A[i] - P[i];
+  }
+  vec3 u = s[0] ^ s[1];
+  if (abs(u[2]) > 1e-2f) {
+    return vec3(1.f - (u.x + u.y) / u.z, u.y / u.z, u.x / u.z);
+  }
+  return vec3(-1, 1, 1);
+}
+
+volatile double sink;
+volatile float origin = 0; // keeps loop-invariant inputs opaque to the optimizer
+
+int main(int argc, char** argv)
+{
+  Model model(argc > 1 ? argv[1] : "obj/african_head.obj");
+  auto nverts = model.nverts();
+  auto nfaces = model.nfaces();
+  if (nfaces == 0) {
+    cerr << "no faces to benchmark" << endl;
+    return 1;
+  }
+
+  vector<vec3> verts(nverts);
+  vector<legacy::vec3> legacy_verts(nverts);
+  vector<vec3i> faces(nfaces);
+  for (auto i = 0; i < nverts; i++) {
+    verts[i] = model.vert(i);
+    legacy_verts[i] = legacy::vec3(verts[i].x, verts[i].y, verts[i].z);
+  }
+  for (auto i = 0; i < nfaces; i++) {
+    auto f = model.face(i);
+    faces[i] = vec3i(f[0], f[1], f[2]);
+  }
+  const int iterations = 2000;
+
+  cout << "face normals (cross + normalize), " << nfaces << " faces" << endl;
+  report("legacy Vec3<double>", time_ns(iterations, nfaces, [&] {
+    double acc = 0;
+    for (auto &f : faces) {
+      auto a = legacy_verts[f.x], b = legacy_verts[f.y], c = legacy_verts[f.z];
+      auto n = (c - a) ^ (b - a);
+      n.normalize();
+      acc += n.z;
+    }
+    sink = acc;
+  }));
+  report("vec3", time_ns(iterations, nfaces, [&] {
+    float acc = 0;
+    for (auto &f : faces) {
+      auto a = verts[f.x], b = verts[f.y], c = verts[f.z];
+      acc += normalize(cross(c - a, b - a)).z;
+    }
+    sink = acc;
+  }));
+  report("vec3x8", time_ns(iterations, nfaces, [&] {
+    float acc = 0;
+    auto i = 0;
+    for (; i + 8 <= nfaces; i += 8) {
+      vec3x8 a, b, c;
+      for (auto k = 0; k < 8; k++) {
+        a.set(k, verts[faces[i + k].x]);
+        b.set(k, verts[faces[i + k].y]);
+        c.set(k, verts[faces[i + k].z]);
+      }
+      auto n = normalize(cross(c - a, b - a));
+      for (auto k = 0; k < 8; k++) acc += n.z[k];
+    }
+    for (; i < nfaces; i++) {
+      auto a = verts[faces[i].x], b = verts[faces[i].y], c = verts[faces[i].z];
+      acc += normalize(cross(c - a, b - a)).z;
+    }
+    sink = acc;
+  }));
+
+  const int side = 64;
+  cout << "barycentric, " << side * side << " points" << endl;
+  report("legacy Vec3<double>", time_ns(iterations, side * side, [&] {
+    double o = origin;
+    legacy::vec3 A(o, o, 0), B(o + side, o, 0), C(o, o + side, 0);
+    double acc = 0;
+    for (auto y = 0; y < side; y++)
+      for (auto x = 0; x < side; x++)
+        {
+          auto bc = legacy::barycentric(A, B, C, legacy::vec3(x, y, 0));
+          acc += bc.x + bc.y + bc.z;
+        }
+    sink = acc;
+  }));
+  report("vec3", time_ns(iterations, side * side, [&] {
+    float o = origin;
+    vec3 A(o, o, 0), B(o + side, o, 0), C(o, o + side, 0);
+    float acc = 0;
+    for (auto y = 0; y < side; y++)
+      for (auto x = 0; x < side; x++)
+        {
+          auto bc = barycentric(A, B, C, vec3(x, y, 0));
+          acc += bc.x + bc.y + bc.z;
+        }
+    sink = acc;
+  }));
+
+  auto m = mat4::identity();
+  m[0][0] = 0.5f; m[1][1] = 0.5f; m[0][3] = 0.25f; m[3][2] = -0.2f;
+  vector<vec3> out(nverts);
+  vector<legacy::vec3> legacy_out(nverts);
+  cout << "mat4 point transform, " << nverts << " vertices" << endl;
+  report("legacy Vec3<double>, by hand", time_ns(iterations, nverts, [&] {
+    for (auto i = 0; i < nverts; i++) {
+      auto &v = legacy_verts[i];
+      auto w = m[3][0] * v.x + m[3][1] * v.y + m[3][2] * v.z + m[3][3];
+      legacy_out[i] = legacy::vec3(
+          (m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z + m[0][3]) / w,
+          (m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z + m[1][3]) / w,
+          (m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z + m[2][3]) / w);
+    }
+    sink = legacy_out[nverts / 2].x;
+  }));
+  report("vec3 AoS", time_ns(iterations, nverts, [&] {
+    transform_points(m, verts.data(), out.data(), nverts);
+    sink = out[nverts / 2].x;
+  }));
+  vector<vec3x4> soa4((nverts + 3) / 4), soa4_out(soa4.size());
+  vector<vec3x8> soa8((nverts + 7) / 8), soa8_out(soa8.size());
+  for (auto i = 0; i < nverts; i++) {
+    soa4[i / 4].set(i % 4, verts[i]);
+    soa8[i / 8].set(i % 8, verts[i]);
+  }
+  report("vec3x4 SoA", time_ns(iterations, nverts, [&] {
+    transform_points(m, soa4.data(), soa4_out.data(), soa4.size());
+    sink = soa4_out[0].x[1];
+  }));
+  report("vec3x8 SoA", time_ns(iterations, nverts, [&] {
+    transform_points(m, soa8.data(), soa8_out.data(), soa8.size());
+    sink = soa8_out[0].x[1];
+  }));
+  return 0;
+}
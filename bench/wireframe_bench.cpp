@@ -0,0 +1,52 @@
+// Wireframe throughput: per-line wu_line calls against the banded renderer.
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "bench.h"
+#include "line.h"
+#include "model.h"
+#include "tgaimage.h"
+
+using namespace std;
+
+int main(int argc, char** argv)
+{
+  const int size = 800;
+  const int iterations = 50;
+  vector<string> files{"obj/african_head.obj", "obj/diablo3_pose.obj"};
+  if (argc > 1) files.assign(argv + 1, argv + argc);
+  TGAColor color(255, 255, 255, 160);
+
+  for (auto &file : files) {
+    Model model(file);
+    auto &edges = model.edges();
+    if (edges.empty()) continue;
+    TGAImage image(size, size, TGAImage::RGB);
+    cout << file << ": " << edges.size() << " unique edges (" << model.nfaces() * 3 << " face edges)" << endl;
+
+    auto screen = [&](int i) {
+      auto v = model.vert(i);
+      return vec2((v.x + 1.f) * size / 2.f, (v.y + 1.f) * size / 2.f);
+    };
+    auto print = [&](const string &name, int lines, double ns_per_model) {
+      cout << "  " << name << ": " << lines * 1e9 / ns_per_model << " lines/s, "
+           << ns_per_model / 1e6 << " ms/model" << endl;
+    };
+
+    print("wu_line per face edge", model.nfaces() * 3, time_ns(iterations, 1, [&] {
+      for (auto i = 0; i < model.nfaces(); i++) {
+        auto f = model.face(i);
+        for (auto j = 0; j < 3; j++) wu_line(screen(f[j]), screen(f[(j + 1) % 3]), image, color);
+      }
+    }));
+    print("wu_line per unique edge", edges.size(), time_ns(iterations, 1, [&] {
+      for (auto &e : edges) wu_line(screen(e.x), screen(e.y), image, color);
+    }));
+    auto max_threads = int(max(1u, thread::hardware_concurrency()));
+    for (auto threads = 1; threads <= max(4, max_threads); threads *= 2) {
+      print("draw_wireframe, " + to_string(threads) + " thread(s)", edges.size(),
+            time_ns(iterations, 1, [&] { draw_wireframe(model, image, color, threads); }));
+    }
+  }
+  return 0;
+}
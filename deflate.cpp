@@ -0,0 +1,462 @@
+#include <algorithm>
+#include <cstring>
+#include <queue>
+#include <utility>
+#include "deflate.h"
+
+using namespace std;
+
+namespace {
+
+const int window_size = 1 << 15;
+const int min_match = 4; // deflate allows 3, but 4-byte hashes are cheaper and lose little
+const int max_match = 258;
+const int hash_bits = 15;
+const size_t block_symbols = 1 << 15;
+const int max_chain[10] = {0, 1, 4, 8, 16, 32, 64, 128, 256, 1024};
+const uint32_t adler_base = 65521;
+
+const int length_base[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                             35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+const int length_extra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                              3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const int dist_base[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                           257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+const int dist_extra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                            7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+// Order in which the code length code's lengths are sent.
+const int cl_order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+struct Tables {
+  unsigned char length_code[max_match + 1];
+  unsigned char dist_code[512]; // d - 1 below 256, else 256 + ((d - 1) >> 7)
+  uint8_t fixed_lit[288], fixed_dist[30];
+  uint32_t crc[256];
+
+  Tables() {
+    for (auto c = 0; c < 29; c++) {
+      for (auto l = length_base[c]; l < length_base[c] + (1 << length_extra[c]) && l <= max_match; l++) {
+        length_code[l] = c; // 258 ends up with code 28, as it must
+      }
+    }
+    for (auto c = 0; c < 30; c++) {
+      for (auto d = dist_base[c]; d < dist_base[c] + (1 << dist_extra[c]); d++) {
+        dist_code[d <= 256 ? d - 1 : 256 + ((d - 1) >> 7)] = c;
+      }
+    }
+    for (auto i = 0; i < 288; i++) {
+      fixed_lit[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+    }
+    fill(fixed_dist, fixed_dist + 30, 5);
+    for (uint32_t n = 0; n < 256; n++) {
+      auto c = n;
+      for (auto k = 0; k < 8; k++) c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+      crc[n] = c;
+    }
+  }
+};
+
+const Tables &tables()
+{
+  static const Tables t;
+  return t;
+}
+
+int dist_code(int d)
+{
+  return tables().dist_code[d <= 256 ? d - 1 : 256 + ((d - 1) >> 7)];
+}
+
+uint32_t hash4(const unsigned char *p)
+{
+  uint32_t v;
+  memcpy(&v, p, 4);
+  return (v * 2654435761u) >> (32 - hash_bits);
+}
+
+int match_length(const unsigned char *a, const unsigned char *b, int limit)
+{
+  auto len = 0;
+  while (len + 8 <= limit) {
+    uint64_t x, y;
+    memcpy(&x, a + len, 8);
+    memcpy(&y, b + len, 8);
+    if (x != y) return len + __builtin_ctzll(x ^ y) / 8;
+    len += 8;
+  }
+  while (len < limit && a[len] == b[len]) len++;
+  return len;
+}
+
+// Huffman code lengths for freq[0..n), none longer than max_bits. The code
+// is always complete, even for a single used symbol, since zlib rejects
+// incomplete code length codes.
+void huffman_lengths(const uint32_t *freq, int n, int max_bits, uint8_t *lengths)
+{
+  fill(lengths, lengths + n, 0);
+  vector<int> used;
+  for (auto i = 0; i < n; i++) {
+    if (freq[i]) used.push_back(i);
+  }
+  if (used.empty()) return;
+  if (used.size() == 1) {
+    lengths[used[0]] = 1;
+    lengths[used[0] == 0 ? 1 : 0] = 1;
+    return;
+  }
+
+  // Plain Huffman tree: leaves 0..m-1, parents always numbered after children.
+  auto m = int(used.size());
+  vector<uint64_t> weight(2 * m - 1);
+  vector<int> parent(2 * m - 1, -1);
+  priority_queue<pair<uint64_t, int>, vector<pair<uint64_t, int> >, greater<pair<uint64_t, int> > > heap;
+  for (auto i = 0; i < m; i++) {
+    weight[i] = freq[used[i]];
+    heap.push(make_pair(weight[i], i));
+  }
+  for (auto next = m; heap.size() > 1; next++) {
+    auto a = heap.top();
+    heap.pop();
+    auto b = heap.top();
+    heap.pop();
+    weight[next] = a.first + b.first;
+    parent[a.second] = parent[b.second] = next;
+    heap.push(make_pair(weight[next], next));
+  }
+  vector<int> depth(2 * m - 1, 0);
+  for (auto i = 2 * m - 3; i >= 0; i--) {
+    depth[i] = depth[parent[i]] + 1;
+  }
+
+  // Clamp to max_bits, then split short codes until the Kraft sum is exact
+  // again; finally hand the longest lengths to the rarest symbols.
+  vector<int> count(max_bits + 1, 0);
+  for (auto i = 0; i < m; i++) {
+    count[min(depth[i], max_bits)]++;
+  }
+  uint32_t total = 0;
+  for (auto len = 1; len <= max_bits; len++) {
+    total += uint32_t(count[len]) << (max_bits - len);
+  }
+  while (total > (1u << max_bits)) {
+    count[max_bits]--;
+    for (auto len = max_bits - 1; len > 0; len--) {
+      if (count[len]) {
+        count[len]--;
+        count[len + 1] += 2;
+        break;
+      }
+    }
+    total--;
+  }
+  sort(used.begin(), used.end(), [&](int a, int b) { return freq[a] != freq[b] ? freq[a] < freq[b] : a < b; });
+  auto k = 0;
+  for (auto len = max_bits; len >= 1; len--) {
+    for (auto i = 0; i < count[len]; i++) {
+      lengths[used[k++]] = len;
+    }
+  }
+}
+
+// Canonical codes for the lengths, bit-reversed since deflate sends Huffman
+// codes most significant bit first into an LSB-first stream.
+void huffman_codes(const uint8_t *lengths, int n, uint16_t *codes)
+{
+  int bl_count[16] = {0}, next[16] = {0};
+  for (auto i = 0; i < n; i++) {
+    bl_count[lengths[i]]++;
+  }
+  bl_count[0] = 0;
+  for (int bits = 1, code = 0; bits < 16; bits++) {
+    code = (code + bl_count[bits - 1]) << 1;
+    next[bits] = code;
+  }
+  for (auto i = 0; i < n; i++) {
+    auto len = lengths[i];
+    if (!len) continue;
+    auto code = next[len]++, reversed = 0;
+    for (auto b = 0; b < len; b++) {
+      reversed = (reversed << 1) | ((code >> b) & 1);
+    }
+    codes[i] = reversed;
+  }
+}
+
+} // namespace
+
+struct Deflater::BitWriter {
+  vector<unsigned char> &out;
+  uint64_t bits;
+  int count;
+
+  explicit BitWriter(vector<unsigned char> &out) : out(out), bits(0), count(0) {}
+
+  void put(uint32_t value, int n) {
+    bits |= uint64_t(value) << count;
+    count += n;
+    if (count >= 32) {
+      unsigned char bytes[4] = {(unsigned char)bits, (unsigned char)(bits >> 8), (unsigned char)(bits >> 16),
+                                (unsigned char)(bits >> 24)};
+      out.insert(out.end(), bytes, bytes + 4);
+      bits >>= 32;
+      count -= 32;
+    }
+  }
+
+  void align() {
+    for (; count > 0; count -= 8) {
+      out.push_back((unsigned char)bits);
+      bits >>= 8;
+    }
+    bits = 0;
+    count = 0;
+  }
+
+  void stored(const unsigned char *data, size_t n, bool final) {
+    put(final, 1);
+    put(0, 2);
+    align();
+    unsigned char header[4] = {(unsigned char)n, (unsigned char)(n >> 8), (unsigned char)~n,
+                               (unsigned char)(~n >> 8)};
+    out.insert(out.end(), header, header + 4);
+    out.insert(out.end(), data, data + n);
+  }
+};
+
+uint32_t adler32(uint32_t adler, const unsigned char *data, size_t n)
+{
+  uint32_t a = adler & 0xffff, b = adler >> 16;
+  while (n > 0) {
+    // 5552 is the most bytes that cannot overflow b before the modulo.
+    auto k = min(n, size_t(5552));
+    n -= k;
+    for (; k > 0; k--) {
+      a += *data++;
+      b += a;
+    }
+    a %= adler_base;
+    b %= adler_base;
+  }
+  return a | (b << 16);
+}
+
+uint32_t adler32_combine(uint32_t a, uint32_t b, size_t length_b)
+{
+  uint32_t rem = length_b % adler_base;
+  uint32_t sum1 = a & 0xffff;
+  uint32_t sum2 = uint32_t(uint64_t(rem) * sum1 % adler_base);
+  sum1 += (b & 0xffff) + adler_base - 1;
+  sum2 += (a >> 16) + (b >> 16) + adler_base - rem;
+  if (sum1 >= adler_base) sum1 -= adler_base;
+  if (sum1 >= adler_base) sum1 -= adler_base;
+  if (sum2 >= 2 * adler_base) sum2 -= 2 * adler_base;
+  if (sum2 >= adler_base) sum2 -= adler_base;
+  return sum1 | (sum2 << 16);
+}
+
+uint32_t crc32(uint32_t crc, const unsigned char *data, size_t n)
+{
+  auto &t = tables();
+  crc = ~crc;
+  for (size_t i = 0; i < n; i++) {
+    crc = t.crc[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+Deflater::Deflater(int level)
+  : level_(min(max(level, 0), 9)), head_(1 << hash_bits), prev_(level_ > 1 ? window_size : 0) {
+  symbols_.reserve(block_symbols);
+}
+
+void Deflater::flush_block(const unsigned char *block, size_t n, bool final, BitWriter &bits)
+{
+  auto &t = tables();
+  uint32_t lit_freq[286] = {0}, dist_freq[30] = {0};
+  uint64_t extra = 0;
+  for (auto &s : symbols_) {
+    if (!s.dist) {
+      lit_freq[s.litlen]++;
+      continue;
+    }
+    int lc = t.length_code[s.litlen], dc = dist_code(s.dist);
+    lit_freq[257 + lc]++;
+    dist_freq[dc]++;
+    extra += length_extra[lc] + dist_extra[dc];
+  }
+  lit_freq[256] = 1;
+
+  uint8_t lit_len[286], dist_len[30];
+  huffman_lengths(lit_freq, 286, 15, lit_len);
+  huffman_lengths(dist_freq, 30, 15, dist_len);
+  if (!*max_element(dist_len, dist_len + 30)) {
+    dist_len[0] = dist_len[1] = 1; // at least one distance code must be sent
+  }
+  auto hlit = 286, hdist = 30;
+  while (hlit > 257 && !lit_len[hlit - 1]) hlit--;
+  while (hdist > 1 && !dist_len[hdist - 1]) hdist--;
+
+  // Run-length code both length tables together (codes 16-18 repeat).
+  uint8_t lengths[286 + 30];
+  copy(lit_len, lit_len + hlit, lengths);
+  copy(dist_len, dist_len + hdist, lengths + hlit);
+  auto total = hlit + hdist;
+  vector<pair<uint8_t, uint8_t> > runs; // symbol, extra bits value
+  uint32_t cl_freq[19] = {0};
+  for (auto i = 0; i < total;) {
+    auto len = lengths[i];
+    auto run = 1;
+    while (i + run < total && lengths[i + run] == len) run++;
+    if (len == 0 && run >= 3) {
+      auto r = min(run, 138);
+      runs.push_back(r >= 11 ? make_pair(uint8_t(18), uint8_t(r - 11)) : make_pair(uint8_t(17), uint8_t(r - 3)));
+      i += r;
+    } else if (len != 0 && run >= 4) {
+      auto r = min(run - 1, 6);
+      runs.push_back(make_pair(len, uint8_t(0)));
+      runs.push_back(make_pair(uint8_t(16), uint8_t(r - 3)));
+      cl_freq[len]++;
+      i += 1 + r;
+    } else {
+      runs.push_back(make_pair(len, uint8_t(0)));
+      i++;
+    }
+    cl_freq[runs.back().first]++;
+  }
+  uint8_t cl_len[19];
+  huffman_lengths(cl_freq, 19, 7, cl_len);
+  auto hclen = 19;
+  while (hclen > 4 && !cl_len[cl_order[hclen - 1]]) hclen--;
+
+  // Pick the cheapest encoding for this block.
+  uint64_t dynamic_bits = 3 + 14 + 3 * hclen + extra, fixed_bits = 3 + extra;
+  for (auto &r : runs) {
+    dynamic_bits += cl_len[r.first] + (r.first == 16 ? 2 : r.first == 17 ? 3 : r.first == 18 ? 7 : 0);
+  }
+  for (auto i = 0; i < 286; i++) {
+    dynamic_bits += uint64_t(lit_freq[i]) * lit_len[i];
+    fixed_bits += uint64_t(lit_freq[i]) * t.fixed_lit[i];
+  }
+  for (auto i = 0; i < 30; i++) {
+    dynamic_bits += uint64_t(dist_freq[i]) * dist_len[i];
+    fixed_bits += uint64_t(dist_freq[i]) * 5;
+  }
+  auto stored_bits = (uint64_t(n) + 5 * ((n + 65534) / 65535)) * 8;
+
+  if (n > 0 && stored_bits < min(dynamic_bits, fixed_bits)) {
+    for (size_t offset = 0; offset < n; offset += 65535) {
+      auto size = min(n - offset, size_t(65535));
+      bits.stored(block + offset, size, final && offset + size == n);
+    }
+    symbols_.clear();
+    return;
+  }
+
+  auto dynamic = dynamic_bits < fixed_bits;
+  bits.put(final, 1);
+  bits.put(dynamic ? 2 : 1, 2);
+  const uint8_t *lit_lengths = t.fixed_lit, *dist_lengths = t.fixed_dist;
+  if (dynamic) {
+    uint16_t cl_codes[19];
+    huffman_codes(cl_len, 19, cl_codes);
+    bits.put(hlit - 257, 5);
+    bits.put(hdist - 1, 5);
+    bits.put(hclen - 4, 4);
+    for (auto i = 0; i < hclen; i++) {
+      bits.put(cl_len[cl_order[i]], 3);
+    }
+    for (auto &r : runs) {
+      bits.put(cl_codes[r.first], cl_len[r.first]);
+      if (r.first == 16) bits.put(r.second, 2);
+      else if (r.first == 17) bits.put(r.second, 3);
+      else if (r.first == 18) bits.put(r.second, 7);
+    }
+    lit_lengths = lit_len;
+    dist_lengths = dist_len;
+  }
+  uint16_t lit_codes[288], dist_codes[30];
+  huffman_codes(lit_lengths, dynamic ? 286 : 288, lit_codes);
+  huffman_codes(dist_lengths, 30, dist_codes);
+
+  for (auto &s : symbols_) {
+    if (!s.dist) {
+      bits.put(lit_codes[s.litlen], lit_lengths[s.litlen]);
+      continue;
+    }
+    int lc = t.length_code[s.litlen], dc = dist_code(s.dist);
+    bits.put(lit_codes[257 + lc], lit_lengths[257 + lc]);
+    bits.put(s.litlen - length_base[lc], length_extra[lc]);
+    bits.put(dist_codes[dc], dist_lengths[dc]);
+    bits.put(s.dist - dist_base[dc], dist_extra[dc]);
+  }
+  bits.put(lit_codes[256], lit_lengths[256]);
+  symbols_.clear();
+}
+
+void Deflater::compress(const unsigned char *data, size_t n, bool final, vector<unsigned char> &out)
+{
+  BitWriter bits(out);
+  if (level_ == 0) {
+    for (size_t offset = 0; offset < n || (final && offset == 0); offset += 65535) {
+      auto size = min(n - offset, size_t(65535));
+      bits.stored(data + offset, size, final && offset + size == n);
+    }
+    return; // stored blocks already end byte-aligned
+  }
+
+  fill(head_.begin(), head_.end(), -1);
+  auto chain_limit = max_chain[level_];
+  auto nice = level_ < 6 ? 64 : max_match;
+  size_t pos = 0, block_start = 0;
+  auto ended = false;
+  while (pos < n) {
+    auto best_len = 0, best_dist = 0;
+    if (n - pos >= size_t(min_match)) {
+      auto h = hash4(data + pos);
+      auto candidate = head_[h];
+      head_[h] = int(pos);
+      if (level_ > 1) prev_[pos & (window_size - 1)] = candidate;
+      auto limit = int(min(n - pos, size_t(max_match)));
+      for (auto chain = chain_limit; candidate >= 0 && pos - candidate <= size_t(window_size);) {
+        auto len = match_length(data + candidate, data + pos, limit);
+        if (len > best_len) {
+          best_len = len;
+          best_dist = int(pos - candidate);
+          if (len >= nice) break;
+        }
+        if (--chain == 0) break;
+        auto next = prev_[candidate & (window_size - 1)];
+        if (next >= candidate) break; // slot reused by a newer position
+        candidate = next;
+      }
+    }
+
+    if (best_len >= min_match) {
+      symbols_.push_back(Symbol{uint16_t(best_len), uint16_t(best_dist)});
+      if (level_ > 1) {
+        for (auto p = pos + 1; p < pos + best_len && n - p >= size_t(min_match); p++) {
+          auto h = hash4(data + p);
+          prev_[p & (window_size - 1)] = head_[h];
+          head_[h] = int(p);
+        }
+      }
+      pos += best_len;
+    } else {
+      symbols_.push_back(Symbol{data[pos], 0});
+      pos++;
+    }
+
+    if (symbols_.size() >= block_symbols) {
+      ended = final && pos == n;
+      flush_block(data + block_start, pos - block_start, ended, bits);
+      block_start = pos;
+    }
+  }
+  if (!ended && (!symbols_.empty() || final)) {
+    flush_block(data + block_start, pos - block_start, final, bits);
+  }
+  if (!final) {
+    bits.stored(nullptr, 0, false);
+  }
+  bits.align();
+}
@@ -0,0 +1,43 @@
+#ifndef __DEFLATE_H__
+#define __DEFLATE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+uint32_t adler32(uint32_t adler, const unsigned char *data, size_t n);
+// Adler-32 of A followed by B, from the checksums of A and B and B's length.
+uint32_t adler32_combine(uint32_t a, uint32_t b, size_t length_b);
+uint32_t crc32(uint32_t crc, const unsigned char *data, size_t n);
+
+// Raw deflate (RFC 1951) compressor. Level 0 stores; level 1 takes the
+// first hash hit and skips hashing inside matches; higher levels follow
+// longer hash chains. Blocks are emitted with dynamic Huffman codes, fixed
+// codes or stored, whichever is smallest. Keeps its tables between calls,
+// so reuse one per thread.
+class Deflater {
+private:
+	struct BitWriter;
+	struct Symbol {
+		uint16_t litlen; // literal byte, or match length when dist > 0
+		uint16_t dist;
+	};
+
+	int level_;
+	vector<int> head_, prev_;
+	vector<Symbol> symbols_;
+
+	void flush_block(const unsigned char *block, size_t n, bool final, BitWriter &bits);
+public:
+	explicit Deflater(int level = 1);
+
+	// Appends the deflate stream for data to out. Unless final, the stream
+	// ends with an empty stored block (a sync flush): byte-aligned and with
+	// no back-references past its end, so another stream can follow.
+	void compress(const unsigned char *data, size_t n, bool final, vector<unsigned char> &out);
+	int level() const { return level_; }
+};
+
+#endif //__DEFLATE_H__
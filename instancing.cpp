@@ -0,0 +1,377 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <thread>
+#include "instancing.h"
+#include "render.h"
+
+using namespace std;
+
+void InstanceBVH::update_bounds(Model &model, const vector<Instance> &instances)
+{
+  lo_.resize(instances.size());
+  hi_.resize(instances.size());
+  for (size_t i = 0; i < instances.size(); i++) {
+    auto &transform = instances[i].transform;
+    auto center = transform_point(transform, model.center());
+    auto extent = sphere_extent(transform, model.radius());
+    lo_[i] = center - extent;
+    hi_[i] = center + extent;
+  }
+}
+
+int InstanceBVH::build_node(int first, int count)
+{
+  auto lo = vec3(numeric_limits<float>::max(), numeric_limits<float>::max(), numeric_limits<float>::max());
+  auto hi = lo * -1.f;
+  auto clo = lo, chi = hi;
+  for (auto i = first; i < first + count; i++) {
+    auto k = order_[i];
+    auto c = (lo_[k] + hi_[k]) * .5f;
+    for (auto a = 0; a < 3; a++) {
+      lo[a] = min(lo[a], lo_[k][a]);
+      hi[a] = max(hi[a], hi_[k][a]);
+      clo[a] = min(clo[a], c[a]);
+      chi[a] = max(chi[a], c[a]);
+    }
+  }
+  auto index = int(nodes_.size());
+  nodes_.push_back(Node{lo, hi, -1, first, count});
+  if (count <= leaf_size) return index;
+
+  // Median split along the axis the centroids spread the most.
+  auto extent = chi - clo;
+  auto axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+  auto half = count / 2;
+  nth_element(order_.begin() + first, order_.begin() + first + half, order_.begin() + first + count,
+              [&](int a, int b) { return lo_[a][axis] + hi_[a][axis] < lo_[b][axis] + hi_[b][axis]; });
+  build_node(first, half);
+  auto right = build_node(first + half, count - half);
+  nodes_[index].right = right;
+  return index;
+}
+
+void InstanceBVH::build(Model &model, const vector<Instance> &instances)
+{
+  update_bounds(model, instances);
+  order_.resize(instances.size());
+  iota(order_.begin(), order_.end(), 0);
+  nodes_.clear();
+  if (!instances.empty()) {
+    build_node(0, int(instances.size()));
+  }
+}
+
+void InstanceBVH::refit(Model &model, const vector<Instance> &instances)
+{
+  if (order_.size() != instances.size()) {
+    build(model, instances);
+    return;
+  }
+  update_bounds(model, instances);
+  // Children always come after their parent, so a backwards walk sees them first.
+  for (auto i = int(nodes_.size()) - 1; i >= 0; i--) {
+    auto &node = nodes_[i];
+    if (node.right < 0) {
+      node.lo = lo_[order_[node.first]];
+      node.hi = hi_[order_[node.first]];
+      for (auto j = node.first + 1; j < node.first + node.count; j++) {
+        auto k = order_[j];
+        for (auto a = 0; a < 3; a++) {
+          node.lo[a] = min(node.lo[a], lo_[k][a]);
+          node.hi[a] = max(node.hi[a], hi_[k][a]);
+        }
+      }
+    } else {
+      auto &left = nodes_[i + 1], &right = nodes_[node.right];
+      for (auto a = 0; a < 3; a++) {
+        node.lo[a] = min(left.lo[a], right.lo[a]);
+        node.hi[a] = max(left.hi[a], right.hi[a]);
+      }
+    }
+  }
+}
+
+InstancedRenderer::InstancedRenderer(int width, int height)
+  : width_(width), height_(height),
+    tiles_x_((width + tile_size - 1) / tile_size), tiles_y_((height + tile_size - 1) / tile_size),
+    cells_x_((width + cell_size - 1) / cell_size), cells_y_((height + cell_size - 1) / cell_size),
+    zbuffer_(width * height), occlusion_depth_(width * height), hiz_(cells_x_ * cells_y_),
+    occluder_budget(0), min_occluder_size(64) {
+}
+
+bool InstancedRenderer::occluded(const vec3 &lo, const vec3 &hi) const
+{
+  // Vertices are rounded to whole pixels, so pad the box by one.
+  auto cx0 = max(0, int(floor((lo.x + 1.f) * width_ / 2.f)) - 1) / cell_size;
+  auto cx1 = min(width_ - 1, int(ceil((hi.x + 1.f) * width_ / 2.f)) + 1) / cell_size;
+  auto cy0 = max(0, int(floor((lo.y + 1.f) * height_ / 2.f)) - 1) / cell_size;
+  auto cy1 = min(height_ - 1, int(ceil((hi.y + 1.f) * height_ / 2.f)) + 1) / cell_size;
+  // hiz_ holds the farthest occluder depth per cell: the box is hidden if its
+  // nearest point lies behind that everywhere it could show.
+  for (auto cy = cy0; cy <= cy1; cy++) {
+    for (auto cx = cx0; cx <= cx1; cx++) {
+      if (hiz_[cy * cells_x_ + cx] <= hi.z) return false;
+    }
+  }
+  return true;
+}
+
+void InstancedRenderer::add_occluder(Model &mesh, const mat4 &transform)
+{
+  const auto view_dir = vec3(0, 0, -1);
+  vector<vec3> world(mesh.nverts());
+  for (auto i = 0; i < mesh.nverts(); i++) {
+    world[i] = mesh.vert(i);
+  }
+  transform_points(transform, world.data(), world.data(), world.size());
+
+  auto xmin = width_, ymin = height_, xmax = -1, ymax = -1;
+  for (auto i = 0; i < mesh.nfaces(); i++) {
+    auto &face = mesh.face(i);
+    vec3 n = (world[face[2]] - world[face[0]]) ^ (world[face[1]] - world[face[0]]);
+    if (n * view_dir <= 0) continue;
+    vec3 pts[3];
+    for (auto j = 0; j < 3; j++) {
+      pts[j] = world2screen(world[face[j]], width_, height_);
+      xmin = min(xmin, int(pts[j].x));
+      xmax = max(xmax, int(pts[j].x));
+      ymin = min(ymin, int(pts[j].y));
+      ymax = max(ymax, int(pts[j].y));
+    }
+    triangle_depth(pts, occlusion_depth_, width_, height_);
+  }
+
+  xmin = max(xmin, 0);
+  ymin = max(ymin, 0);
+  xmax = min(xmax, width_ - 1);
+  ymax = min(ymax, height_ - 1);
+  if (xmin > xmax || ymin > ymax) return;
+  for (auto cy = ymin / cell_size; cy <= ymax / cell_size; cy++) {
+    for (auto cx = xmin / cell_size; cx <= xmax / cell_size; cx++) {
+      auto farthest = numeric_limits<float>::max();
+      for (auto y = cy * cell_size; y < min((cy + 1) * cell_size, height_); y++) {
+        auto row = occlusion_depth_.data() + size_t(y) * width_;
+        for (auto x = cx * cell_size; x < min((cx + 1) * cell_size, width_); x++) {
+          farthest = min(farthest, row[x]);
+        }
+      }
+      hiz_[cy * cells_x_ + cx] = farthest;
+    }
+  }
+}
+
+void InstancedRenderer::cull(Model &model, const vector<Instance> &instances, InstanceStats &stats)
+{
+  fill(occlusion_depth_.begin(), occlusion_depth_.end(), -numeric_limits<float>::max());
+  fill(hiz_.begin(), hiz_.end(), -numeric_limits<float>::max());
+  visible_.clear();
+  if (bvh_.nodes_.empty()) return;
+
+  auto outside = [](const vec3 &lo, const vec3 &hi) {
+    return hi.x < -1.f || lo.x > 1.f || hi.y < -1.f || lo.y > 1.f;
+  };
+
+  // Front to back (larger z is nearer), so the occluders come first.
+  vector<int> stack(1, 0);
+  while (!stack.empty()) {
+    auto &node = bvh_.nodes_[stack.back()];
+    stack.pop_back();
+    stats.nodes_visited++;
+    if (outside(node.lo, node.hi)) {
+      stats.frustum_culled += node.count;
+      continue;
+    }
+    if (occluded(node.lo, node.hi)) {
+      stats.occlusion_culled += node.count;
+      continue;
+    }
+    if (node.right >= 0) {
+      auto left = int(&node - bvh_.nodes_.data()) + 1, right = node.right;
+      if (bvh_.nodes_[left].hi.z > bvh_.nodes_[right].hi.z) swap(left, right);
+      stack.push_back(left);
+      stack.push_back(right);
+      continue;
+    }
+
+    for (auto i = node.first; i < node.first + node.count; i++) {
+      auto k = bvh_.order_[i];
+      auto &lo = bvh_.lo_[k], &hi = bvh_.hi_[k];
+      if (outside(lo, hi)) {
+        stats.frustum_culled++;
+        continue;
+      }
+      if (occluded(lo, hi)) {
+        stats.occlusion_culled++;
+        continue;
+      }
+      visible_.push_back(k);
+      auto size = max((hi.x - lo.x) * width_, (hi.y - lo.y) * height_) / 2.f;
+      if (stats.occluders < occluder_budget && size >= min_occluder_size) {
+        auto &transform = instances[k].transform;
+        add_occluder(model.lod(lod_level(model, transform, width_, height_)), transform);
+        stats.occluders++;
+      }
+    }
+  }
+}
+
+void InstancedRenderer::bin(Model &model, const vector<Instance> &instances, int begin, int end, vec3 light_dir,
+                            vector<BinnedTriangle> &binned, vector<vector<int> > &bins)
+{
+  const auto view_dir = vec3(0, 0, -1);
+  binned.clear();
+  for (auto &tile : bins) {
+    tile.clear();
+  }
+
+  vector<vec3> world;
+  for (auto v = begin; v < end; v++) {
+    auto &instance = instances[visible_[v]];
+    auto &mesh = model.lod(lod_level(model, instance.transform, width_, height_));
+    world.resize(mesh.nverts());
+    for (auto i = 0; i < mesh.nverts(); i++) {
+      world[i] = mesh.vert(i);
+    }
+    transform_points(instance.transform, world.data(), world.data(), world.size());
+
+    for (auto i = 0; i < mesh.nfaces(); i++) {
+      auto &face = mesh.face(i);
+      vec3 n = (world[face[2]] - world[face[0]]) ^ (world[face[1]] - world[face[0]]);
+      n.normalize();
+      if (n * view_dir <= 0) continue;
+      BinnedTriangle t;
+      for (auto j = 0; j < 3; j++) {
+        t.pts[j] = world2screen(world[face[j]], width_, height_);
+      }
+      auto &A = t.pts[0], &B = t.pts[1], &C = t.pts[2];
+      // Small instances round many faces down to nothing; rasterize() would
+      // drop them anyway, so keep them out of the bins.
+      if (abs((C.x - A.x) * (B.y - A.y) - (B.x - A.x) * (C.y - A.y)) <= 1e-2f) continue;
+      auto xmin = max(0, int(min({t.pts[0].x, t.pts[1].x, t.pts[2].x})));
+      auto xmax = min(width_ - 1, int(max({t.pts[0].x, t.pts[1].x, t.pts[2].x})));
+      auto ymin = max(0, int(min({t.pts[0].y, t.pts[1].y, t.pts[2].y})));
+      auto ymax = min(height_ - 1, int(max({t.pts[0].y, t.pts[1].y, t.pts[2].y})));
+      if (xmin > xmax || ymin > ymax) continue;
+      t.color = TGAColor(instance.color) * max(0.f, n * light_dir);
+      auto index = int(binned.size());
+      binned.push_back(t);
+      for (auto ty = ymin / tile_size; ty <= ymax / tile_size; ty++) {
+        for (auto tx = xmin / tile_size; tx <= xmax / tile_size; tx++) {
+          bins[ty * tiles_x_ + tx].push_back(index);
+        }
+      }
+    }
+  }
+}
+
+void InstancedRenderer::raster_tile(int tile, TGAImage &image)
+{
+  auto x0 = tile % tiles_x_ * tile_size, y0 = tile / tiles_x_ * tile_size;
+  auto x1 = min(x0 + tile_size, width_) - 1, y1 = min(y0 + tile_size, height_) - 1;
+  auto bytespp = image.get_bytespp();
+  auto data = image.buffer();
+  for (auto y = y0; y <= y1; y++) {
+    auto row = zbuffer_.begin() + size_t(y) * width_;
+    fill(row + x0, row + x1 + 1, -numeric_limits<float>::max());
+    memset(data + (size_t(y) * width_ + x0) * bytespp, 0, (x1 - x0 + 1) * bytespp);
+  }
+  // Instances are binned front to back, so in a crowd most triangles land
+  // behind what is already drawn. Skip a triangle before any edge setup when
+  // every depth in its box is nearer than its nearest vertex (plus a margin
+  // for interpolation rounding, so the output does not change).
+  auto hidden = [&](const BinnedTriangle &t) {
+    auto &A = t.pts[0], &B = t.pts[1], &C = t.pts[2];
+    auto xmin = max(x0, int(min({A.x, B.x, C.x}))), xmax = min(x1, int(max({A.x, B.x, C.x})));
+    auto ymin = max(y0, int(min({A.y, B.y, C.y}))), ymax = min(y1, int(max({A.y, B.y, C.y})));
+    auto z = max({A.z, B.z, C.z});
+    z += 1e-4f * (1.f + abs(z));
+    auto visible = 0;
+    for (auto y = ymin; y <= ymax; y++) {
+      auto row = zbuffer_.data() + size_t(y) * width_;
+      for (auto x = xmin; x <= xmax; x++) {
+        visible += row[x] < z;
+      }
+      if (visible) return false;
+    }
+    return true;
+  };
+  // Threads' bins in order, so the result does not depend on scheduling.
+  for (size_t i = 0; i < bins_.size(); i++) {
+    for (auto index : bins_[i][tile]) {
+      auto &t = binned_[i][index];
+      if (hidden(t)) continue;
+      rasterize(t.pts, zbuffer_.data(), width_, vec2i(x0, y0), vec2i(x1, y1),
+                [&](int x, int y, const vec3 &) {
+                  memcpy(data + (size_t(y) * width_ + x) * bytespp, t.color.raw, bytespp);
+                });
+    }
+  }
+}
+
+InstanceStats InstancedRenderer::render(Model &model, const vector<Instance> &instances, TGAImage &image,
+                                        vec3 light_dir, bool rebuild, int nthreads)
+{
+  InstanceStats stats = {};
+  if (image.get_width() != width_ || image.get_height() != height_) {
+    cerr << "can't render instances into a " << image.get_width() << "x" << image.get_height()
+         << " image, the renderer is " << width_ << "x" << height_ << "\n";
+    return stats;
+  }
+  stats.instances = int(instances.size());
+  if (rebuild || bvh_.order_.size() != instances.size()) {
+    bvh_.build(model, instances);
+  } else {
+    bvh_.refit(model, instances);
+  }
+  cull(model, instances, stats);
+
+  if (nthreads <= 0) {
+    nthreads = max(1u, thread::hardware_concurrency());
+  }
+  auto ntiles = tiles_x_ * tiles_y_;
+  binned_.resize(nthreads);
+  bins_.resize(nthreads);
+  for (auto &bins : bins_) {
+    bins.resize(ntiles);
+  }
+
+  // Each thread bins a contiguous share of the visible instances, then all
+  // of them pull whole tiles until none are left.
+  auto nvisible = int(visible_.size());
+  atomic<int> next_tile(0);
+  vector<thread> threads;
+  auto binner = [&](int i) {
+    bin(model, instances, i * nvisible / nthreads, (i + 1) * nvisible / nthreads, light_dir,
+        binned_[i], bins_[i]);
+  };
+  auto rasterizer = [&]() {
+    for (auto tile = next_tile++; tile < ntiles; tile = next_tile++) {
+      raster_tile(tile, image);
+    }
+  };
+  for (auto i = 1; i < nthreads; i++) {
+    threads.emplace_back(binner, i);
+  }
+  binner(0);
+  for (auto &t : threads) {
+    t.join();
+  }
+  threads.clear();
+  for (auto i = 1; i < nthreads; i++) {
+    threads.emplace_back(rasterizer);
+  }
+  rasterizer();
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  for (auto i = 0; i < nthreads; i++) {
+    stats.triangles += int(binned_[i].size());
+  }
+  return stats;
+}
@@ -0,0 +1,105 @@
+#ifndef __INSTANCING_H__
+#define __INSTANCING_H__
+
+#include <vector>
+#include "tgaimage.h"
+#include "model.h"
+#include "vec.h"
+
+using namespace std;
+
+struct Instance {
+	mat4 transform;
+	TGAColor color;
+};
+
+struct InstanceStats {
+	int instances;
+	int frustum_culled;
+	int occlusion_culled;
+	int occluders;
+	int nodes_visited;
+	int triangles;
+};
+
+// Bounding-volume hierarchy over the bounding spheres of placed instances.
+// Nodes are stored depth first: a node's left child follows it directly and
+// `right` indexes the other one, so refit() can walk the array backwards.
+// Every node's instances are a contiguous range of order_.
+class InstanceBVH {
+private:
+	struct Node {
+		vec3 lo, hi;
+		int right; // -1 for leaves
+		int first, count;
+	};
+	vector<Node> nodes_;
+	vector<int> order_;
+	vector<vec3> lo_, hi_;
+
+	void update_bounds(Model &model, const vector<Instance> &instances);
+	int build_node(int first, int count);
+
+	friend class InstancedRenderer;
+public:
+	static const int leaf_size = 4;
+
+	// Rebuilds the tree with median splits along the widest axis.
+	void build(Model &model, const vector<Instance> &instances);
+	// Keeps the topology and recomputes bounds bottom-up; cheap, but the
+	// tree degrades if instances move far.
+	void refit(Model &model, const vector<Instance> &instances);
+	int size() const { return (int)nodes_.size(); }
+};
+
+// Draws many placed copies of one Model (with its LOD chain, if built).
+// Each frame: refit or rebuild the BVH; walk it front to back, dropping
+// nodes outside the view and (with an occluder budget) nodes hidden behind
+// a coarse depth grid fed by a depth-only pass over the nearest accepted
+// instances; then transform and bin the survivors' triangles on all threads
+// and rasterize the screen tiles in parallel, one thread per tile at a time,
+// skipping triangles whose box is already covered by nearer pixels.
+class InstancedRenderer {
+private:
+	struct BinnedTriangle {
+		vec3 pts[3];
+		TGAColor color;
+	};
+
+	int width_, height_;
+	int tiles_x_, tiles_y_;
+	int cells_x_, cells_y_;
+	vector<float> zbuffer_;
+	vector<float> occlusion_depth_;
+	vector<float> hiz_;
+	vector<int> visible_;
+	vector<vector<BinnedTriangle> > binned_; // [thread]
+	vector<vector<vector<int> > > bins_; // [thread][tile], indices into binned_[thread]
+	InstanceBVH bvh_;
+
+	bool occluded(const vec3 &lo, const vec3 &hi) const;
+	void add_occluder(Model &mesh, const mat4 &transform);
+	void cull(Model &model, const vector<Instance> &instances, InstanceStats &stats);
+	void bin(Model &model, const vector<Instance> &instances, int begin, int end, vec3 light_dir,
+	         vector<BinnedTriangle> &binned, vector<vector<int> > &bins);
+	void raster_tile(int tile, TGAImage &image);
+public:
+	static const int tile_size = 64;
+	static const int cell_size = 8;
+
+	// Up to occluder_budget of the nearest visible instances that cover at
+	// least min_occluder_size pixels are drawn into the occlusion grid. Off
+	// by default: the tiles already skip triangles behind what they have
+	// drawn, and in the crowd bench the pre-pass costs more than it saves.
+	int occluder_budget;
+	float min_occluder_size;
+
+	InstancedRenderer(int width, int height);
+	// image must be width x height; any other size is refused and left
+	// untouched.
+	InstanceStats render(Model &model, const vector<Instance> &instances, TGAImage &image,
+	                     vec3 light_dir, bool rebuild = false, int nthreads = 0);
+	const InstanceBVH &bvh() const { return bvh_; }
+};
+
+#endif //__INSTANCING_H__
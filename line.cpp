@@ -0,0 +1,282 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "line.h"
+
+using namespace std;
+
+void bresenham_line(vec2i start, vec2i end, TGAImage &image, TGAColor color)
+{
+  auto steep = abs(end.y - start.y) > abs(end.x - start.x);
+  if (steep) {
+    swap(start.x, start.y);
+    swap(end.x, end.y);
+  }
+  if (start.x > end.x) {
+    swap(start, end);
+  }
+  auto dx = end.x - start.x;
+  auto dy = abs(end.y - start.y);
+  auto derr2 = abs(dy) * 2;
+  auto err2 = 0;
+  auto y = start.y;
+  auto ystep = end.y > start.y ? 1 : -1;
+  for (int x = start.x; x <= end.x; x++) {
+    if (steep) {
+      image.set(y, x, color);
+    } else {
+      image.set(x, y, color);
+    }
+    err2 += derr2;
+    if (err2 > dx) {
+      y += ystep;
+      err2 -= 2 * dx;
+    }
+  }
+}
+
+#define ipart(X) ((int)(X))
+#define fpart(X) (((float)(X))-(float)ipart(X))
+#define rfpart(X) (1.0f-fpart(X))
+
+void wu_line(vec2 start, vec2 end, TGAImage &image, TGAColor color)
+{
+  auto steep = abs(end.y - start.y) > abs(end.x - start.x);
+  if (steep) {
+    swap(start.x, start.y);
+    swap(end.x, end.y);
+  }
+  if (start.x > end.x) {
+    swap(start, end);
+  }
+
+  auto dx = end.x - start.x;
+  auto dy = end.y - start.y;
+  auto gradient = (dx == 0) ? 1.0f : dy / dx;
+
+  // Draw the first endpoint.
+  auto xend = round(start.x);
+  auto yend = start.y + gradient * (xend - start.x);
+  auto xgap = rfpart(start.x + 0.5);
+  auto xpxl1 = xend;
+  auto ypxl1 = ipart(yend);
+  auto intery = yend + gradient;
+  if (steep) {
+    image.set(ypxl1, xpxl1, color * rfpart(yend) * xgap);
+    image.set(ypxl1 + 1, xpxl1, color * fpart(yend) * xgap);
+  } else {
+    image.set(xpxl1, ypxl1, color * rfpart(yend) * xgap);
+    image.set(xpxl1, ypxl1 + 1, color * fpart(yend) * xgap);
+  }
+
+  // Draw the other endpoint.
+  xend = round(end.x);
+  yend = end.y + gradient * (xend - end.x);
+  xgap = fpart(end.x + 0.5);
+  auto xpxl2 = xend;
+  auto ypxl2 = ipart(yend);
+  if (steep) {
+    image.set(ypxl2, xpxl2, color * rfpart(yend) * xgap);
+    image.set(ypxl2 + 1, xpxl2, color * fpart(yend) * xgap);
+  } else {
+    image.set(xpxl2, ypxl2, color * rfpart(yend) * xgap);
+    image.set(xpxl2, ypxl2 + 1, color * fpart(yend) * xgap);
+  }
+
+  // Main loop.
+  if (steep) {
+    for (auto x = xpxl1 + 1; x < xpxl2; x++) {
+      image.set(ipart(intery), x, color * rfpart(intery));
+      image.set(ipart(intery) + 1, x, color * fpart(intery));
+      intery += gradient;
+    }
+  } else {
+    for (auto x = xpxl1 + 1; x < xpxl2; x++) {
+      image.set(x, ipart(intery), color * rfpart(intery));
+      image.set(x, ipart(intery) + 1, color * fpart(intery));
+      intery += gradient;
+    }
+  }
+}
+
+void line(vec2 start, vec2 end, TGAImage &image, TGAColor color)
+{
+  wu_line(start, end, image, color);
+}
+
+namespace {
+
+constexpr int band_height = 16;
+
+// Screen-space edge in 16.16 fixed point.
+struct FixedEdge {
+  int32_t x0, y0, x1, y1;
+};
+
+inline int floor_div(int a, int b)
+{
+  return a / b - (a % b < 0);
+}
+
+inline int32_t to_fixed(float v)
+{
+  return int32_t(lround(v * 65536.f));
+}
+
+// Blends color into the pixel at p with an 8-bit coverage in [0, 256].
+template <int bytespp> inline void blend(unsigned char *p, const TGAColor &color, int coverage)
+{
+  auto alpha = (coverage * (color.a + 1)) >> 8;
+  for (auto t = 0; t < bytespp; t++) {
+    p[t] += ((int(color.raw[t]) - p[t]) * alpha) >> 8;
+  }
+}
+
+// Draws the part of an edge that falls on rows [row0, row1). The major axis
+// is stepped one pixel at a time; the minor coordinate is carried in fixed
+// point and its fractional byte splits coverage between two pixels.
+template <int bytespp>
+void draw_edge_in_band(const FixedEdge &e, unsigned char *data, int width,
+                       int row0, int row1, const TGAColor &color)
+{
+  auto x0 = e.x0, y0 = e.y0, x1 = e.x1, y1 = e.y1;
+  auto plot = [&](int x, int y, int coverage) {
+    if (x >= 0 && x < width && y >= row0 && y < row1 && coverage > 0) {
+      blend<bytespp>(data + (size_t(y) * width + x) * bytespp, color, coverage);
+    }
+  };
+
+  if (abs(y1 - y0) > abs(x1 - x0)) {
+    // Y-major: the band bounds clip the loop directly.
+    if (y0 > y1) {
+      swap(x0, x1);
+      swap(y0, y1);
+    }
+    auto gradient = (int64_t(x1 - x0) << 16) / (y1 - y0);
+    auto ys = max(int((y0 + 32768) >> 16), row0);
+    auto ye = min(int((y1 + 32768) >> 16), row1 - 1);
+    for (auto y = ys; y <= ye; y++) {
+      auto x = x0 + int32_t(((int64_t(y) << 16) - y0) * gradient >> 16);
+      auto frac = (x >> 8) & 255;
+      plot(x >> 16, y, 256 - frac);
+      plot((x >> 16) + 1, y, frac);
+    }
+    return;
+  }
+
+  // X-major: step x, but only over the columns whose y can reach the band.
+  if (x0 > x1) {
+    swap(x0, x1);
+    swap(y0, y1);
+  }
+  auto xs = int((x0 + 32768) >> 16);
+  auto xe = int((x1 + 32768) >> 16);
+  if (x1 == x0) {
+    plot(xs, y0 >> 16, 256);
+    return;
+  }
+  auto gradient = (int64_t(y1 - y0) << 16) / (x1 - x0);
+  auto inside = min(y0, y1) >= (int64_t(row0) << 16) && max(y0, y1) < (int64_t(row1 - 1) << 16);
+  if (gradient != 0 && !inside) {
+    auto x_at = [&](int row) {
+      return x0 + ((int64_t(row) << 16) - y0) * 65536 / gradient;
+    };
+    auto xa = x_at(row0 - 1), xb = x_at(row1);
+    if (xa > xb) swap(xa, xb);
+    xs = max<int64_t>(xs, (xa >> 16) - 1);
+    xe = min<int64_t>(xe, (xb >> 16) + 1);
+  }
+  xs = max(xs, 0);
+  xe = min(xe, width - 1);
+  for (auto x = xs; x <= xe; x++) {
+    auto y = y0 + int32_t(((int64_t(x) << 16) - x0) * gradient >> 16);
+    auto frac = (y >> 8) & 255;
+    plot(x, y >> 16, 256 - frac);
+    plot(x, (y >> 16) + 1, frac);
+  }
+}
+
+template <int bytespp>
+void draw_band(const FixedEdge *begin, const FixedEdge *end, unsigned char *data, int width,
+               int row0, int row1, const TGAColor &color)
+{
+  for (auto e = begin; e != end; e++) {
+    draw_edge_in_band<bytespp>(*e, data, width, row0, row1, color);
+  }
+}
+
+} // namespace
+
+WireframeStats draw_wireframe(Model &model, TGAImage &image, TGAColor color, int nthreads)
+{
+  auto width = image.get_width();
+  auto height = image.get_height();
+  auto bytespp = image.get_bytespp();
+  auto data = image.buffer();
+  auto &edges = model.edges();
+
+  vector<vec2> screen(model.nverts());
+  for (auto i = 0; i < model.nverts(); i++) {
+    auto v = model.vert(i);
+    screen[i] = vec2((v.x + 1.f) * width / 2.f, (v.y + 1.f) * height / 2.f);
+  }
+
+  // Bin each edge into every band its rows (plus AA spill) overlap: count,
+  // prefix-sum, then scatter into one flat array.
+  auto nbands = (height + band_height - 1) / band_height;
+  vector<FixedEdge> fixed(edges.size());
+  vector<vec2i> span(edges.size());
+  vector<int> band_start(nbands + 1, 0);
+  for (size_t i = 0; i < edges.size(); i++) {
+    auto a = screen[edges[i].x], b = screen[edges[i].y];
+    fixed[i] = FixedEdge{to_fixed(a.x), to_fixed(a.y), to_fixed(b.x), to_fixed(b.y)};
+    // X-major edges start at the rounded endpoint column, up to half a pixel
+    // outside the edge, so they can reach one row above floor(min y) too.
+    auto lo = max(0, floor_div(int(floor(min(a.y, b.y))) - 1, band_height));
+    auto hi = min(nbands - 1, floor_div(int(ceil(max(a.y, b.y))) + 1, band_height));
+    span[i] = vec2i(lo, hi);
+    for (auto band = lo; band <= hi; band++) band_start[band + 1]++;
+  }
+  for (auto band = 0; band < nbands; band++) {
+    band_start[band + 1] += band_start[band];
+  }
+  vector<int> fill_pos(band_start.begin(), band_start.end() - 1);
+  vector<FixedEdge> binned(band_start[nbands]);
+  for (size_t i = 0; i < edges.size(); i++) {
+    for (auto band = span[i].x; band <= span[i].y; band++) {
+      binned[fill_pos[band]++] = fixed[i];
+    }
+  }
+
+  if (nthreads <= 0) {
+    nthreads = max(1u, thread::hardware_concurrency());
+  }
+  nthreads = min(nthreads, nbands);
+
+  atomic<int> next_band(0);
+  auto worker = [&]() {
+    for (auto band = next_band++; band < nbands; band = next_band++) {
+      auto row0 = band * band_height;
+      auto row1 = min(row0 + band_height, height);
+      auto begin = binned.data() + band_start[band];
+      auto end = binned.data() + band_start[band + 1];
+      switch (bytespp) {
+      case TGAImage::GRAYSCALE: draw_band<1>(begin, end, data, width, row0, row1, color); break;
+      case TGAImage::RGB: draw_band<3>(begin, end, data, width, row0, row1, color); break;
+      case TGAImage::RGBA: draw_band<4>(begin, end, data, width, row0, row1, color); break;
+      }
+    }
+  };
+  vector<thread> threads;
+  for (auto i = 1; i < nthreads; i++) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto &t : threads) {
+    t.join();
+  }
+  return WireframeStats{int(edges.size()), nthreads};
+}
@@ -0,0 +1,25 @@
+#ifndef __LINE_H__
+#define __LINE_H__
+
+#include "tgaimage.h"
+#include "model.h"
+#include "vec.h"
+
+void bresenham_line(vec2i start, vec2i end, TGAImage &image, TGAColor color);
+void wu_line(vec2 start, vec2 end, TGAImage &image, TGAColor color);
+void line(vec2 start, vec2 end, TGAImage &image, TGAColor color);
+
+struct WireframeStats {
+	int lines;
+	int threads;
+};
+
+// Draws every unique edge of the model as an anti-aliased, alpha-blended
+// line. Vertices map from [-1, 1] to the screen as in the triangle pass but
+// are not rounded to whole pixels; endpoints are snapped to 16.16 fixed
+// point instead, so lines can sit up to half a pixel off filled edges. The image is cut into
+// horizontal bands and each band is owned by exactly one thread, so no two
+// threads ever touch the same pixel. nthreads <= 0 picks one per core.
+WireframeStats draw_wireframe(Model &model, TGAImage &image, TGAColor color, int nthreads = 0);
+
+#endif //__LINE_H__
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <fstream>
@@ -5,10 +6,11 @@
 #include <string>
 #include <vector>
 #include "model.h"
+#include "simplify.h"
 
 using namespace std;
 
-Model::Model(const string filename) : verts_(), faces_() {
+Model::Model(const string filename) : verts_(), faces_(), edges_(), center_(), radius_(0), lods_() {
     ifstream in;
     in.open (filename, ifstream::in);
     if (in.fail()) return;
@@ -35,9 +37,41 @@ Model::Model(const string filename) : verts_(), faces_() {
             faces_.push_back(f);
         }
     }
+    build_topology();
     cerr << "# v# " << verts_.size() << " f# "  << faces_.size() << endl;
 }
 
+Model::Model(const vector<vec3> &verts, const vector<vector<int> > &faces)
+    : verts_(verts), faces_(faces), edges_(), center_(), radius_(0), lods_() {
+    build_topology();
+}
+
+void Model::build_topology() {
+    for (auto &f : faces_) {
+        for (size_t i = 0; i < f.size(); i++) {
+            int a = f[i], b = f[(i + 1) % f.size()];
+            edges_.push_back(a < b ? vec2i(a, b) : vec2i(b, a));
+        }
+    }
+    sort(edges_.begin(), edges_.end(), [](const vec2i &a, const vec2i &b) {
+        return a.x < b.x || (a.x == b.x && a.y < b.y);
+    });
+    edges_.erase(unique(edges_.begin(), edges_.end(), [](const vec2i &a, const vec2i &b) {
+        return a.x == b.x && a.y == b.y;
+    }), edges_.end());
+
+    if (verts_.empty()) return;
+    vec3 lo = verts_[0], hi = verts_[0];
+    for (auto &v : verts_) {
+        lo = vec3(min(lo.x, v.x), min(lo.y, v.y), min(lo.z, v.z));
+        hi = vec3(max(hi.x, v.x), max(hi.y, v.y), max(hi.z, v.z));
+    }
+    center_ = (lo + hi) * .5f;
+    for (auto &v : verts_) {
+        radius_ = max(radius_, (v - center_).length());
+    }
+}
+
 Model::~Model() {
 }
 
@@ -49,11 +83,52 @@ int Model::nfaces() {
     return (int)faces_.size();
 }
 
-vector<int> Model::face(int idx) {
+const vector<int> &Model::face(int idx) {
     return faces_[idx];
 }
 
+const vector<vec2i> &Model::edges() {
+    return edges_;
+}
+
 vec3 Model::vert(int i) {
     return verts_[i];
 }
 
+
+vec3 Model::center() {
+    return center_;
+}
+
+float Model::radius() {
+    return radius_;
+}
+
+void Model::build_lods(int levels, float ratio) {
+    lods_.clear();
+    lods_.reserve(levels);
+    for (int i = 1; i < levels; i++) {
+        int prev_faces = lod(i - 1).nfaces();
+        int target = int(prev_faces * ratio);
+        if (target < 4) break;
+        Model next = simplify(lod(i - 1), target);
+        if (next.nfaces() >= prev_faces) break;
+        lods_.push_back(next);
+    }
+}
+
+int Model::nlods() {
+    return 1 + (int)lods_.size();
+}
+
+Model &Model::lod(int level) {
+    return level == 0 ? *this : lods_[level - 1];
+}
+
+int Model::lod_level(float screen_size, float pixels_per_triangle) {
+    float budget = screen_size * screen_size / pixels_per_triangle;
+    for (int i = 0; i < nlods(); i++) {
+        if (lod(i).nfaces() <= budget) return i;
+    }
+    return nlods() - 1;
+}
@@ -11,13 +11,33 @@ class Model {
 private:
 	vector<vec3> verts_;
 	vector<vector<int> > faces_;
+	vector<vec2i> edges_;
+	vec3 center_;
+	float radius_;
+	vector<Model> lods_;
+	void build_topology();
 public:
 	Model(const string filename);
+	Model(const vector<vec3> &verts, const vector<vector<int> > &faces);
 	~Model();
 	int nverts();
 	int nfaces();
 	vec3 vert(int i);
-	vector<int> face(int idx);
+	const vector<int> &face(int idx);
+	// Unique undirected edges (lower index first); shared edges appear once.
+	const vector<vec2i> &edges();
+	// Bounding sphere of the vertices.
+	vec3 center();
+	float radius();
+
+	// Builds a chain of simplified copies, each with about `ratio` times the
+	// faces of the previous one. Level 0 is this model.
+	void build_lods(int levels = 5, float ratio = .5f);
+	int nlods();
+	Model &lod(int level);
+	// Most detailed level that still averages at least pixels_per_triangle
+	// pixels per face when the bounding sphere spans screen_size pixels.
+	int lod_level(float screen_size, float pixels_per_triangle = 8.f);
 };
 
 #endif //__MODEL_H__
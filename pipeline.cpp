@@ -0,0 +1,180 @@
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <thread>
+#include "model.h"
+#include "pipeline.h"
+#include "png.h"
+#include "qoi.h"
+#include "render.h"
+#include "writer.h"
+
+using namespace std;
+
+namespace {
+
+// Seconds since `mark`, moving the mark to now.
+double lap(chrono::steady_clock::time_point &mark)
+{
+  auto now = chrono::steady_clock::now();
+  auto seconds = chrono::duration<double>(now - mark).count();
+  mark = now;
+  return seconds;
+}
+
+struct Loaded {
+  size_t job;
+  unique_ptr<Model> model;
+};
+
+// image is null when the job's model loaded no faces.
+struct Rendered {
+  size_t job;
+  unique_ptr<TGAImage> image;
+};
+
+unique_ptr<TGAImage> render_job(Model &model, const FrameJob &job, int width, int height, vec3 light_dir,
+                                vector<float> &zbuffer)
+{
+  auto image = make_unique<TGAImage>(width, height, TGAImage::RGB);
+  fill(zbuffer.begin(), zbuffer.end(), -numeric_limits<float>::max());
+  draw_instance(model, job.transform, *image, zbuffer, job.color, light_dir, false);
+  return image;
+}
+
+// Picks the encoder from the output's extension; anything else is TGA.
+void encode(TGAImage &image, const string &filename, vector<unsigned char> &bytes)
+{
+  auto ends_with = [&](const char *suffix) {
+    auto n = strlen(suffix);
+    return filename.size() >= n && filename.compare(filename.size() - n, n, suffix) == 0;
+  };
+  if (ends_with(".png")) {
+    encode_png(image, bytes);
+  } else if (ends_with(".qoi")) {
+    encode_qoi(image, bytes);
+  } else {
+    image.encode_tga(bytes);
+  }
+}
+
+PipelineStats render_serial(const vector<FrameJob> &jobs, int width, int height, vec3 light_dir)
+{
+  PipelineStats stats = {};
+  vector<float> zbuffer(width * height);
+  vector<unsigned char> bytes;
+  auto start = chrono::steady_clock::now(), mark = start;
+  for (auto &job : jobs) {
+    Model model(job.model);
+    stats.load.busy += lap(mark);
+    if (!model.nfaces()) {
+      cerr << "can't load model " << job.model << "\n";
+      stats.failures++;
+      continue;
+    }
+    auto image = render_job(model, job, width, height, light_dir, zbuffer);
+    stats.render.busy += lap(mark);
+    image->flip_vertically();
+    encode(*image, job.output, bytes);
+    stats.write.busy += lap(mark);
+    ofstream out(job.output, ios::binary);
+    out.write((char *)bytes.data(), bytes.size());
+    if (out.good()) {
+      stats.bytes += bytes.size();
+    } else {
+      cerr << "can't write file " << job.output << "\n";
+      stats.failures++;
+    }
+    out.close();
+    auto io = lap(mark);
+    stats.io_seconds += io;
+    stats.write.blocked += io;
+    stats.frames++;
+  }
+  stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  return stats;
+}
+
+} // namespace
+
+PipelineStats render_frames(const vector<FrameJob> &jobs, int width, int height, vec3 light_dir,
+                            int queue_depth, bool use_io_uring)
+{
+  if (queue_depth <= 0) {
+    return render_serial(jobs, width, height, light_dir);
+  }
+
+  PipelineStats stats = {};
+  BoundedQueue<Loaded> loaded(queue_depth);
+  BoundedQueue<Rendered> rendered(queue_depth);
+  auto start = chrono::steady_clock::now();
+
+  thread loader([&] {
+    auto mark = chrono::steady_clock::now();
+    for (size_t i = 0; i < jobs.size(); i++) {
+      auto model = make_unique<Model>(jobs[i].model);
+      stats.load.busy += lap(mark);
+      loaded.push(Loaded{i, move(model)});
+      stats.load.blocked += lap(mark);
+    }
+    loaded.close();
+  });
+
+  thread renderer([&] {
+    vector<float> zbuffer(width * height);
+    auto mark = chrono::steady_clock::now();
+    Loaded item;
+    while (loaded.pop(item)) {
+      stats.render.starved += lap(mark);
+      unique_ptr<TGAImage> image;
+      if (item.model->nfaces()) {
+        image = render_job(*item.model, jobs[item.job], width, height, light_dir, zbuffer);
+      }
+      item.model.reset();
+      stats.render.busy += lap(mark);
+      rendered.push(Rendered{item.job, move(image)});
+      stats.render.blocked += lap(mark);
+    }
+    stats.render.starved += lap(mark);
+    rendered.close();
+  });
+
+  // Encode on this thread; the writer keeps up to queue_depth files in flight.
+  {
+    AsyncWriter writer(queue_depth, use_io_uring);
+    auto mark = chrono::steady_clock::now();
+    auto load_failures = 0;
+    Rendered item;
+    while (rendered.pop(item)) {
+      stats.write.starved += lap(mark);
+      if (!item.image) {
+        cerr << "can't load model " << jobs[item.job].model << "\n";
+        load_failures++;
+        continue;
+      }
+      vector<unsigned char> bytes;
+      item.image->flip_vertically();
+      encode(*item.image, jobs[item.job].output, bytes);
+      item.image.reset();
+      stats.write.busy += lap(mark);
+      writer.submit(jobs[item.job].output, move(bytes));
+      stats.write.blocked += lap(mark);
+      stats.frames++;
+    }
+    stats.write.starved += lap(mark);
+    writer.drain();
+    stats.write.blocked += lap(mark);
+    stats.io_seconds = writer.busy_seconds();
+    stats.bytes = writer.bytes_written();
+    stats.io_uring = writer.uses_io_uring();
+    stats.failures = writer.failures() + load_failures;
+  }
+
+  loader.join();
+  renderer.join();
+  stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  return stats;
+}
@@ -0,0 +1,84 @@
+#ifndef __PIPELINE_H__
+#define __PIPELINE_H__
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "tgaimage.h"
+#include "vec.h"
+
+using namespace std;
+
+// Fixed-capacity FIFO between two threads. push() blocks while the queue
+// is full, so a slow consumer stalls its producer instead of letting frames
+// pile up; pop() blocks while it is empty and returns false once the queue
+// is closed and drained.
+template <class T> class BoundedQueue {
+private:
+	size_t capacity_;
+	deque<T> items_;
+	bool closed_;
+	mutex mutex_;
+	condition_variable not_full_, not_empty_;
+public:
+	explicit BoundedQueue(size_t capacity) : capacity_(capacity), closed_(false) {}
+
+	void push(T item) {
+		unique_lock<mutex> lock(mutex_);
+		not_full_.wait(lock, [&] { return items_.size() < capacity_; });
+		items_.push_back(move(item));
+		not_empty_.notify_one();
+	}
+
+	bool pop(T &item) {
+		unique_lock<mutex> lock(mutex_);
+		not_empty_.wait(lock, [&] { return closed_ || !items_.empty(); });
+		if (items_.empty()) return false;
+		item = move(items_.front());
+		items_.pop_front();
+		not_full_.notify_one();
+		return true;
+	}
+
+	void close() {
+		lock_guard<mutex> lock(mutex_);
+		closed_ = true;
+		not_empty_.notify_all();
+	}
+};
+
+// One output image: which model to load, where to put it, where to write it.
+struct FrameJob {
+	string model;
+	mat4 transform;
+	TGAColor color;
+	string output;
+};
+
+// Seconds a stage spent working, waiting for its input and waiting for room
+// in its output (backpressure).
+struct StageStats {
+	double busy, starved, blocked;
+};
+
+struct PipelineStats {
+	int frames;
+	double seconds;
+	StageStats load, render, write;
+	double io_seconds; // time with a file write outstanding
+	size_t bytes;
+	bool io_uring;
+	int failures;
+};
+
+// Loads, renders (draw_instance() without LOD) and writes each job as PNG,
+// QOI or RLE TGA by the output's extension. With queue_depth > 0 the three
+// stages run on their own threads joined by queues of that many frames, and
+// writes go through AsyncWriter; with queue_depth 0 everything runs in
+// order on the calling thread with blocking writes, as main() used to.
+PipelineStats render_frames(const vector<FrameJob> &jobs, int width, int height, vec3 light_dir,
+                            int queue_depth = 2, bool use_io_uring = true);
+
+#endif //__PIPELINE_H__
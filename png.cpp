@@ -0,0 +1,224 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include "deflate.h"
+#include "png.h"
+
+using namespace std;
+
+namespace {
+
+// Uncompressed bytes per stripe: big enough that restarting the deflate
+// window costs little, small enough to spread over the threads.
+const size_t stripe_bytes = 1 << 17;
+
+enum Filter { NONE, SUB, UP, AVERAGE, PAETH };
+
+struct Stripe {
+  vector<unsigned char> data;
+  uint32_t adler;
+  uint32_t crc;
+  size_t length;
+};
+
+void put32(vector<unsigned char> &out, uint32_t v)
+{
+  unsigned char bytes[4] = {(unsigned char)(v >> 24), (unsigned char)(v >> 16), (unsigned char)(v >> 8),
+                            (unsigned char)v};
+  out.insert(out.end(), bytes, bytes + 4);
+}
+
+void chunk(vector<unsigned char> &out, const char *type, const unsigned char *data, size_t n)
+{
+  put32(out, uint32_t(n));
+  auto start = out.size();
+  out.insert(out.end(), type, type + 4);
+  out.insert(out.end(), data, data + n);
+  put32(out, crc32(0, out.data() + start, n + 4));
+}
+
+unsigned char paeth(int a, int b, int c)
+{
+  auto p = a + b - c;
+  auto pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+  return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+}
+
+// BGR(A) to RGB(A), one row at a time, so the filters below see PNG byte
+// order without a converted copy of the whole image.
+template <int bpp>
+void swizzle_row(const unsigned char *src, int width, unsigned char *dst)
+{
+  if (bpp == 1) {
+    copy(src, src + width, dst);
+    return;
+  }
+  for (auto x = 0; x < width; x++, src += bpp, dst += bpp) {
+    dst[0] = src[2];
+    dst[1] = src[1];
+    dst[2] = src[0];
+    if (bpp == 4) dst[3] = src[3];
+  }
+}
+
+// Writes the filter byte and the filtered row to dst; prev is the row above,
+// all zeros for the first row.
+template <int bpp>
+void filter_row(Filter filter, const unsigned char *row, const unsigned char *prev, size_t n, unsigned char *dst)
+{
+  *dst++ = filter;
+  switch (filter) {
+  case NONE:
+    copy(row, row + n, dst);
+    break;
+  case SUB:
+    copy(row, row + bpp, dst);
+    for (auto i = size_t(bpp); i < n; i++) dst[i] = row[i] - row[i - bpp];
+    break;
+  case UP:
+    for (size_t i = 0; i < n; i++) dst[i] = row[i] - prev[i];
+    break;
+  case AVERAGE:
+    for (size_t i = 0; i < bpp; i++) dst[i] = row[i] - (prev[i] >> 1);
+    for (auto i = size_t(bpp); i < n; i++) dst[i] = row[i] - ((row[i - bpp] + prev[i]) >> 1);
+    break;
+  case PAETH:
+    for (size_t i = 0; i < bpp; i++) dst[i] = row[i] - prev[i];
+    for (auto i = size_t(bpp); i < n; i++) dst[i] = row[i] - paeth(row[i - bpp], prev[i], prev[i - bpp]);
+    break;
+  }
+}
+
+// Fixed filter at level 1; otherwise the usual heuristic: the filter whose
+// output, read as signed bytes, has the smallest absolute sum.
+template <int bpp>
+void filter_rows(const unsigned char *image, int width, int y0, int y1, int level, unsigned char *dst,
+                 vector<unsigned char> &rows)
+{
+  auto row_bytes = size_t(width) * bpp;
+  rows.assign(3 * (row_bytes + 1), 0);
+  auto prev = rows.data(), row = prev + row_bytes, scratch = row + row_bytes;
+  if (y0 > 0) swizzle_row<bpp>(image + (y0 - 1) * row_bytes, width, prev);
+  for (auto y = y0; y < y1; y++, dst += row_bytes + 1) {
+    swizzle_row<bpp>(image + y * row_bytes, width, row);
+    if (level <= 1) {
+      filter_row<bpp>(level ? UP : NONE, row, prev, row_bytes, dst);
+    } else {
+      auto best = ~0ull;
+      for (auto filter : {NONE, SUB, UP, AVERAGE, PAETH}) {
+        filter_row<bpp>(filter, row, prev, row_bytes, scratch);
+        auto sum = 0ull;
+        for (size_t i = 1; i <= row_bytes; i++) {
+          sum += abs(int((signed char)scratch[i]));
+        }
+        if (sum < best) {
+          best = sum;
+          copy(scratch, scratch + row_bytes + 1, dst);
+        }
+      }
+    }
+    swap(prev, row);
+  }
+}
+
+} // namespace
+
+bool encode_png(TGAImage &image, vector<unsigned char> &out, int level, int nthreads)
+{
+  auto width = image.get_width(), height = image.get_height(), bpp = image.get_bytespp();
+  auto data = image.buffer();
+  if (!data || width <= 0 || height <= 0 || (bpp != 1 && bpp != 3 && bpp != 4)) return false;
+
+  auto row_bytes = size_t(width) * bpp;
+  auto stripe_rows = int(max(size_t(1), stripe_bytes / (row_bytes + 1)));
+  auto nstripes = (height + stripe_rows - 1) / stripe_rows;
+  vector<Stripe> stripes(nstripes);
+  const unsigned char idat[4] = {'I', 'D', 'A', 'T'};
+  auto idat_crc = crc32(0, idat, 4);
+
+  if (nthreads <= 0) {
+    nthreads = max(1u, thread::hardware_concurrency());
+  }
+  nthreads = min(nthreads, nstripes);
+  atomic<int> next_stripe(0);
+  auto worker = [&]() {
+    Deflater deflater(level);
+    vector<unsigned char> filtered, rows;
+    for (auto s = next_stripe++; s < nstripes; s = next_stripe++) {
+      auto y0 = s * stripe_rows, y1 = min(y0 + stripe_rows, height);
+      filtered.resize((y1 - y0) * (row_bytes + 1));
+      switch (bpp) {
+      case 1: filter_rows<1>(data, width, y0, y1, level, filtered.data(), rows); break;
+      case 3: filter_rows<3>(data, width, y0, y1, level, filtered.data(), rows); break;
+      case 4: filter_rows<4>(data, width, y0, y1, level, filtered.data(), rows); break;
+      }
+      auto &stripe = stripes[s];
+      stripe.data.clear();
+      if (s == 0) {
+        // zlib header: deflate, 32K window, FLEVEL to match, FCHECK so it divides by 31.
+        stripe.data.push_back(0x78);
+        stripe.data.push_back(level <= 1 ? 0x01 : level <= 5 ? 0x5e : level == 6 ? 0x9c : 0xda);
+      }
+      deflater.compress(filtered.data(), filtered.size(), s == nstripes - 1, stripe.data);
+      stripe.adler = adler32(1, filtered.data(), filtered.size());
+      stripe.length = filtered.size();
+      stripe.crc = crc32(idat_crc, stripe.data.data(), stripe.data.size());
+    }
+  };
+  vector<thread> threads;
+  for (auto i = 1; i < nthreads; i++) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  out.clear();
+  const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+  out.insert(out.end(), signature, signature + 8);
+  unsigned char ihdr[13] = {
+    (unsigned char)(width >> 24), (unsigned char)(width >> 16), (unsigned char)(width >> 8), (unsigned char)width,
+    (unsigned char)(height >> 24), (unsigned char)(height >> 16), (unsigned char)(height >> 8), (unsigned char)height,
+    8, (unsigned char)(bpp == 1 ? 0 : bpp == 3 ? 2 : 6), 0, 0, 0,
+  };
+  chunk(out, "IHDR", ihdr, sizeof(ihdr));
+  auto adler = 1u;
+  for (auto &stripe : stripes) {
+    put32(out, uint32_t(stripe.data.size()));
+    out.insert(out.end(), idat, idat + 4);
+    out.insert(out.end(), stripe.data.begin(), stripe.data.end());
+    put32(out, stripe.crc);
+    adler = adler32_combine(adler, stripe.adler, stripe.length);
+  }
+  // The zlib trailer goes in a chunk of its own so no stripe's CRC depends on it.
+  unsigned char trailer[4] = {(unsigned char)(adler >> 24), (unsigned char)(adler >> 16),
+                              (unsigned char)(adler >> 8), (unsigned char)adler};
+  chunk(out, "IDAT", trailer, 4);
+  chunk(out, "IEND", nullptr, 0);
+  return true;
+}
+
+bool write_png_file(TGAImage &image, const char *filename, int level, int nthreads)
+{
+  vector<unsigned char> bytes;
+  if (!encode_png(image, bytes, level, nthreads)) {
+    cerr << "can't encode the png file\n";
+    return false;
+  }
+  ofstream out(filename, ios::binary);
+  if (!out.is_open()) {
+    cerr << "can't open file " << filename << "\n";
+    return false;
+  }
+  out.write((char *)bytes.data(), bytes.size());
+  if (!out.good()) {
+    cerr << "can't dump the png file\n";
+    return false;
+  }
+  return true;
+}
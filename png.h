@@ -0,0 +1,19 @@
+#ifndef __PNG_H__
+#define __PNG_H__
+
+#include <vector>
+#include "tgaimage.h"
+
+using namespace std;
+
+// Encodes the image as an 8-bit greyscale, RGB or RGBA PNG (following its
+// bytespp), rows in buffer order like write_tga_file(). Pixels are filtered
+// and swizzled from BGR straight out of the image buffer, a stripe of rows
+// at a time. Stripes are compressed on up to nthreads threads (0: one per
+// core) as independent deflate streams joined by sync flushes, each one
+// its own IDAT chunk. level is the Deflater level: 0 stores, 1 is fast and
+// uses the Up filter throughout, 2 and above pick a filter per row.
+bool encode_png(TGAImage &image, vector<unsigned char> &out, int level = 1, int nthreads = 0);
+bool write_png_file(TGAImage &image, const char *filename, int level = 1, int nthreads = 0);
+
+#endif //__PNG_H__
@@ -0,0 +1,145 @@
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include "qoi.h"
+
+using namespace std;
+
+namespace {
+
+enum {
+  OP_INDEX = 0x00,
+  OP_DIFF = 0x40,
+  OP_LUMA = 0x80,
+  OP_RUN = 0xc0,
+  OP_RGB = 0xfe,
+  OP_RGBA = 0xff,
+};
+
+unsigned char *put32(unsigned char *p, uint32_t v)
+{
+  *p++ = v >> 24;
+  *p++ = v >> 16;
+  *p++ = v >> 8;
+  *p++ = v;
+  return p;
+}
+
+// Returns the end of the encoded pixel data; p must have room for the worst
+// case, one byte more than the pixel itself for every pixel.
+template <int bpp>
+unsigned char *encode_pixels(const unsigned char *data, size_t npixels, unsigned char *p)
+{
+  struct Pixel {
+    unsigned char r, g, b, a;
+    bool operator ==(const Pixel &o) const { return r == o.r && g == o.g && b == o.b && a == o.a; }
+  };
+  Pixel index[64] = {};
+  Pixel prev = {0, 0, 0, 255};
+  auto run = 0;
+  for (size_t i = 0; i < npixels; i++, data += bpp) {
+    Pixel px;
+    if (bpp == 1) {
+      px = Pixel{data[0], data[0], data[0], 255};
+    } else {
+      px = Pixel{data[2], data[1], data[0], bpp == 4 ? data[3] : (unsigned char)255};
+    }
+
+    if (px == prev) {
+      if (++run == 62) {
+        *p++ = OP_RUN | (run - 1);
+        run = 0;
+      }
+      continue;
+    }
+    if (run > 0) {
+      *p++ = OP_RUN | (run - 1);
+      run = 0;
+    }
+
+    auto h = (px.r * 3 + px.g * 5 + px.b * 7 + px.a * 11) % 64;
+    if (index[h] == px) {
+      *p++ = OP_INDEX | h;
+    } else if (px.a != prev.a) {
+      index[h] = px;
+      *p++ = OP_RGBA;
+      *p++ = px.r;
+      *p++ = px.g;
+      *p++ = px.b;
+      *p++ = px.a;
+    } else {
+      index[h] = px;
+      int dr = (signed char)(px.r - prev.r), dg = (signed char)(px.g - prev.g), db = (signed char)(px.b - prev.b);
+      auto dr_dg = dr - dg, db_dg = db - dg;
+      if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+        *p++ = OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2);
+      } else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7) {
+        *p++ = OP_LUMA | (dg + 32);
+        *p++ = (dr_dg + 8) << 4 | (db_dg + 8);
+      } else {
+        *p++ = OP_RGB;
+        *p++ = px.r;
+        *p++ = px.g;
+        *p++ = px.b;
+      }
+    }
+    prev = px;
+  }
+  if (run > 0) {
+    *p++ = OP_RUN | (run - 1);
+  }
+  return p;
+}
+
+} // namespace
+
+bool encode_qoi(TGAImage &image, vector<unsigned char> &out)
+{
+  auto width = image.get_width(), height = image.get_height(), bpp = image.get_bytespp();
+  auto data = image.buffer();
+  if (!data || width <= 0 || height <= 0 || (bpp != 1 && bpp != 3 && bpp != 4)) return false;
+
+  auto npixels = size_t(width) * height;
+  auto channels = bpp == 4 ? 4 : 3;
+  const unsigned char padding[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+  out.resize(14 + npixels * (channels + 1) + sizeof(padding));
+  auto p = out.data();
+  *p++ = 'q';
+  *p++ = 'o';
+  *p++ = 'i';
+  *p++ = 'f';
+  p = put32(p, width);
+  p = put32(p, height);
+  *p++ = channels;
+  *p++ = 0; // sRGB
+  switch (bpp) {
+  case 1: p = encode_pixels<1>(data, npixels, p); break;
+  case 3: p = encode_pixels<3>(data, npixels, p); break;
+  case 4: p = encode_pixels<4>(data, npixels, p); break;
+  }
+  for (auto b : padding) {
+    *p++ = b;
+  }
+  out.resize(p - out.data());
+  return true;
+}
+
+bool write_qoi_file(TGAImage &image, const char *filename)
+{
+  vector<unsigned char> bytes;
+  if (!encode_qoi(image, bytes)) {
+    cerr << "can't encode the qoi file\n";
+    return false;
+  }
+  ofstream out(filename, ios::binary);
+  if (!out.is_open()) {
+    cerr << "can't open file " << filename << "\n";
+    return false;
+  }
+  out.write((char *)bytes.data(), bytes.size());
+  if (!out.good()) {
+    cerr << "can't dump the qoi file\n";
+    return false;
+  }
+  return true;
+}
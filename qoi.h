@@ -0,0 +1,16 @@
+#ifndef __QOI_H__
+#define __QOI_H__
+
+#include <vector>
+#include "tgaimage.h"
+
+using namespace std;
+
+// Encodes the image as QOI (RGB, or RGBA for 4-byte images; greyscale is
+// widened to RGB), rows in buffer order like write_tga_file(). Reads the
+// buffer directly. Single-threaded: every QOI op depends on the previous
+// pixel and the running colour index, so the stream cannot be split.
+bool encode_qoi(TGAImage &image, vector<unsigned char> &out);
+bool write_qoi_file(TGAImage &image, const char *filename);
+
+#endif //__QOI_H__
@@ -0,0 +1,158 @@
+#include <limits>
+#include "render.h"
+
+using namespace std;
+
+vec3 world2screen(const vec3 &v, int width, int height) {
+  return vec3(int((v.x+1.f)*width/2.f+.5f), int((v.y+1.f)*height/2.f+.5f), v.z);
+}
+
+void triangle(const vec3 pts[3], vector<float> &zbuffer, TGAImage &image, TGAColor color)
+{
+  rasterize(pts, zbuffer.data(), image.get_width(), image.get_height(), [&](int x, int y, const vec3 &) {
+    image.set(x, y, color);
+  });
+}
+
+void triangle_depth(const vec3 pts[3], vector<float> &zbuffer, int width, int height)
+{
+  rasterize(pts, zbuffer.data(), width, height, DepthOnly());
+}
+
+ShadowMap::ShadowMap(int size, vec3 light_dir)
+  : size_(size), light_dir_(normalize(light_dir)), transform_(mat4::identity()),
+    depth_(size * size, -numeric_limits<float>::max()), texel_(0) {
+}
+
+void ShadowMap::render(Model &model)
+{
+  // Light basis with z pointing back at the light, so nearer to the light is
+  // larger z, as in the main zbuffer.
+  auto z = -light_dir_;
+  auto up = abs(z.y) > .99f ? vec3(1, 0, 0) : vec3(0, 1, 0);
+  auto x = normalize(cross(up, z));
+  auto y = cross(z, x);
+  auto view = mat4::identity();
+  for (auto j = 0; j < 3; j++) {
+    view[0][j] = x[j];
+    view[1][j] = y[j];
+    view[2][j] = z[j];
+  }
+
+  // Fit the model's light-space footprint into the map, one texel of border.
+  vec2 lo(numeric_limits<float>::max(), numeric_limits<float>::max());
+  vec2 hi(-numeric_limits<float>::max(), -numeric_limits<float>::max());
+  for (auto i = 0; i < model.nverts(); i++) {
+    auto p = transform_point(view, model.vert(i));
+    lo = vec2(min(lo.x, p.x), min(lo.y, p.y));
+    hi = vec2(max(hi.x, p.x), max(hi.y, p.y));
+  }
+  auto scale = (size_ - 3) / max(hi.x - lo.x, hi.y - lo.y);
+  auto viewport = mat4::identity();
+  viewport[0][0] = scale;
+  viewport[1][1] = scale;
+  viewport[0][3] = 1 - lo.x * scale;
+  viewport[1][3] = 1 - lo.y * scale;
+  transform_ = viewport * view;
+  // Depth stays in world units.
+  texel_ = 1.f / scale;
+
+  fill(depth_.begin(), depth_.end(), -numeric_limits<float>::max());
+  for (auto i = 0; i < model.nfaces(); i++) {
+    auto &face = model.face(i);
+    vec3 pts[3];
+    for (auto j = 0; j < 3; j++) {
+      pts[j] = transform_point(transform_, model.vert(face[j]));
+    }
+    triangle_depth(pts, depth_, size_, size_);
+  }
+}
+
+float ShadowMap::lit(const vec3 &world, const vec3 &normal) const
+{
+  auto p = transform_point(transform_, world + normal * (2 * texel_));
+  auto cx = int(lround(p.x)), cy = int(lround(p.y));
+  auto count = 0;
+  for (auto dy = -1; dy <= 1; dy++) {
+    auto sy = min(max(cy + dy, 0), size_ - 1);
+    for (auto dx = -1; dx <= 1; dx++) {
+      auto sx = min(max(cx + dx, 0), size_ - 1);
+      count += depth_[sy * size_ + sx] <= p.z + texel_;
+    }
+  }
+  return count / 9.f;
+}
+
+void draw_model(Model &model, TGAImage &image, TGAColor color, vec3 light_dir, const ShadowMap *shadow)
+{
+  const auto view_dir = vec3(0, 0, -1);
+  const auto ambient = .15f;
+  auto width = image.get_width();
+  auto height = image.get_height();
+  vector<float> zbuffer(width * height);
+  fill(zbuffer.begin(), zbuffer.end(), -numeric_limits<float>::max());
+  for (auto i = 0; i < model.nfaces(); i++) {
+    auto &face = model.face(i);
+    vec3 screen_coords[3];
+    vec3 world_coords[3];
+    for (auto j = 0; j < 3; j++) {
+      auto v = model.vert(face[j]);
+      screen_coords[j] = world2screen(v, width, height);
+      world_coords[j] = v;
+    }
+    vec3 n = (world_coords[2] - world_coords[0]) ^ (world_coords[1] - world_coords[0]);
+    n.normalize();
+    if (n * view_dir <= 0) continue;
+    auto intensity = max(0.f, n * light_dir);
+    if (!shadow) {
+      triangle(screen_coords, zbuffer, image, color * intensity);
+      continue;
+    }
+    rasterize(screen_coords, zbuffer.data(), width, height, [&](int x, int y, const vec3 &bc) {
+      auto world = world_coords[0] * bc.x + world_coords[1] * bc.y + world_coords[2] * bc.z;
+      auto light = intensity > 0 ? intensity * shadow->lit(world, -n) : 0.f;
+      image.set(x, y, color * (ambient + (1 - ambient) * light));
+    });
+  }
+}
+
+int lod_level(Model &model, const mat4 &transform, int width, int height)
+{
+  // NDC spans width (height) pixels over 2 units in x (y), so the projected
+  // diameter is the larger of the sphere's half-extents scaled by each.
+  auto extent = sphere_extent(transform, model.radius());
+  return model.lod_level(max(extent.x * width, extent.y * height));
+}
+
+int draw_instance(Model &model, const mat4 &transform, TGAImage &image, vector<float> &zbuffer,
+                  TGAColor color, vec3 light_dir, bool use_lod)
+{
+  const auto view_dir = vec3(0, 0, -1);
+  auto width = image.get_width();
+  auto height = image.get_height();
+  auto mesh = &model;
+  if (use_lod) {
+    mesh = &model.lod(lod_level(model, transform, width, height));
+  }
+
+  vector<vec3> world(mesh->nverts());
+  for (auto i = 0; i < mesh->nverts(); i++) {
+    world[i] = mesh->vert(i);
+  }
+  transform_points(transform, world.data(), world.data(), world.size());
+
+  auto triangles = 0;
+  for (auto i = 0; i < mesh->nfaces(); i++) {
+    auto &face = mesh->face(i);
+    vec3 n = (world[face[2]] - world[face[0]]) ^ (world[face[1]] - world[face[0]]);
+    n.normalize();
+    if (n * view_dir <= 0) continue;
+    vec3 pts[3];
+    for (auto j = 0; j < 3; j++) {
+      pts[j] = world2screen(world[face[j]], width, height);
+    }
+    triangle(pts, zbuffer, image, color * max(0.f, n * light_dir));
+    triangles++;
+  }
+  return triangles;
+}
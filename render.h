@@ -0,0 +1,146 @@
+#ifndef __RENDER_H__
+#define __RENDER_H__
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <vector>
+#include "tgaimage.h"
+#include "model.h"
+#include "vec.h"
+
+using namespace std;
+
+vec3 world2screen(const vec3 &v, int width, int height);
+
+// Fragment for passes that only want the zbuffer filled.
+struct DepthOnly {
+  void operator ()(int, int, const vec3 &) const {}
+};
+
+// Shared triangle loop behind every pass. A pixel is covered when all three
+// edge functions are >= 0 at its integer point; they are evaluated as affine
+// functions of (x, y) and each row is trimmed to the span the triangle can
+// touch. Only pixels inside [clip_min, clip_max] are
+// touched. The zbuffer keeps the largest z. fragment(x, y, bc) runs after a
+// pixel passes the depth test; with DepthOnly the loop drops to coverage
+// and depth alone.
+template <class Fragment>
+void rasterize(const vec3 pts[3], float *zbuffer, int width, vec2i clip_min, vec2i clip_max, Fragment fragment)
+{
+  auto &A = pts[0], &B = pts[1], &C = pts[2];
+  auto det = (C.x - A.x) * (B.y - A.y) - (B.x - A.x) * (C.y - A.y);
+  if (abs(det) <= 1e-2f) return; // degenerate
+
+  // Unnormalized edge functions e1 = e1x * x + e1y * y + e1c (likewise e2,
+  // and e0 = det - e1 - e2), flipped so that inside is e >= 0. With integer
+  // vertices these are exact, so shared edges are resolved consistently;
+  // bc = e / det only once a pixel is known to be covered.
+  auto sign = det < 0 ? -1.f : 1.f;
+  auto e1x = -(C.y - A.y) * sign, e1y = (C.x - A.x) * sign;
+  auto e1c = (A.x * (C.y - A.y) - (C.x - A.x) * A.y) * sign;
+  auto e2x = (B.y - A.y) * sign, e2y = -(B.x - A.x) * sign;
+  auto e2c = ((B.x - A.x) * A.y - A.x * (B.y - A.y)) * sign;
+  auto area = det * sign;
+  auto inv = 1.f / area;
+
+  auto xmin = max(clip_min.x, int(ceil(min({A.x, B.x, C.x}))));
+  auto xmax = min(clip_max.x, int(floor(max({A.x, B.x, C.x}))));
+  auto ymin = max(clip_min.y, int(ceil(min({A.y, B.y, C.y}))));
+  auto ymax = min(clip_max.y, int(floor(max({A.y, B.y, C.y}))));
+
+  for (auto y = ymin; y <= ymax; y++) {
+    auto r1 = e1y * y + e1c, r2 = e2y * y + e2c;
+
+    // Each edge function is linear in x along the row, so its sign change
+    // bounds the span. Widen by a pixel to absorb rounding; the per-pixel
+    // test below stays exact.
+    auto lo = float(xmin), hi = float(xmax);
+    auto clip = [&](float a, float c) {
+      if (a > 0) lo = max(lo, floor(-c / a) - 1);
+      else if (a < 0) hi = min(hi, ceil(-c / a) + 1);
+      else if (c < 0) hi = lo - 1;
+    };
+    clip(e1x, r1);
+    clip(e2x, r2);
+    clip(-(e1x + e2x), area - r1 - r2);
+    if (lo > hi) continue;
+    auto x0 = int(lo), x1 = int(hi);
+
+    auto row = zbuffer + size_t(y) * width;
+    if constexpr (is_same<Fragment, DepthOnly>::value) {
+      // Nothing else reads the coverage, so test and depth-write without
+      // branches and let the compiler vectorize the span.
+      auto z0 = A.z, dz1 = (B.z - A.z) * inv, dz2 = (C.z - A.z) * inv;
+      for (auto x = x0; x <= x1; x++) {
+        auto e1 = e1x * x + r1, e2 = e2x * x + r2;
+        auto e0 = area - e1 - e2;
+        auto z = z0 + dz1 * e1 + dz2 * e2;
+        auto covered = (e0 >= 0) & (e1 >= 0) & (e2 >= 0);
+        row[x] = max(row[x], covered ? z : -numeric_limits<float>::max());
+      }
+      continue;
+    }
+    for (auto x = x0; x <= x1; x++) {
+      auto e1 = e1x * x + r1, e2 = e2x * x + r2;
+      auto e0 = area - e1 - e2;
+      if (e0 < 0 || e1 < 0 || e2 < 0) continue;
+      vec3 bc(e0 * inv, e1 * inv, e2 * inv);
+      auto z = A.z * bc.x + B.z * bc.y + C.z * bc.z;
+      if (row[x] < z) {
+        row[x] = z;
+        fragment(x, y, bc);
+      }
+    }
+  }
+}
+
+template <class Fragment>
+void rasterize(const vec3 pts[3], float *zbuffer, int width, int height, Fragment fragment)
+{
+  rasterize(pts, zbuffer, width, vec2i(0, 0), vec2i(width - 1, height - 1), fragment);
+}
+
+void triangle(const vec3 pts[3], vector<float> &zbuffer, TGAImage &image, TGAColor color);
+
+// Depth-only variant: no colour writes and no attribute interpolation. Used
+// for shadow maps and occlusion pre-passes.
+void triangle_depth(const vec3 pts[3], vector<float> &zbuffer, int width, int height);
+
+// Orthographic depth map seen along a directional light.
+class ShadowMap {
+  private:
+    int size_;
+    vec3 light_dir_;
+    mat4 transform_;
+    vector<float> depth_;
+    float texel_;
+  public:
+    ShadowMap(int size, vec3 light_dir);
+    // Fits the light frustum to the model and renders its depth.
+    void render(Model &model);
+    // Fraction of a 3x3 PCF kernel around the world-space point that sees the
+    // light, in [0, 1]. The point is pushed off the surface along its outward
+    // normal by a couple of texels to keep grazing faces free of acne.
+    float lit(const vec3 &world, const vec3 &normal) const;
+    int size() const { return size_; }
+    const vector<float> &depth() const { return depth_; }
+};
+
+// Flat-shaded model pass. The view looks down -z; faces facing away from it
+// are skipped. With a shadow map, shading is evaluated per pixel.
+void draw_model(Model &model, TGAImage &image, TGAColor color, vec3 light_dir,
+                const ShadowMap *shadow = nullptr);
+
+// LOD level for a placed copy of a model on a width x height screen.
+int lod_level(Model &model, const mat4 &transform, int width, int height);
+
+// Draws one placed copy of a model into a shared zbuffer, flat shaded like
+// draw_model(). With use_lod the mesh comes from the model's LOD chain,
+// chosen by the projected diameter of its bounding sphere. Returns the
+// number of triangles handed to the rasterizer.
+int draw_instance(Model &model, const mat4 &transform, TGAImage &image, vector<float> &zbuffer,
+                  TGAColor color, vec3 light_dir, bool use_lod = true);
+
+#endif //__RENDER_H__
@@ -0,0 +1,194 @@
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include "render.h"
+#include "session.h"
+
+using namespace std;
+
+RenderSession::RenderSession(int width, int height, vec3 light_dir)
+  : width_(width), height_(height),
+    tiles_x_((width + tile_size - 1) / tile_size), tiles_y_((height + tile_size - 1) / tile_size),
+    light_dir_(light_dir), objects_(), triangle_color_(),
+    zbuffer_(width * height, -numeric_limits<float>::max()), ids_(width * height, -1),
+    dirty_tiles_(tiles_x_ * tiles_y_, 1), stale_tiles_(tiles_x_ * tiles_y_, 0), reshade_all_(true),
+    image_(width, height, TGAImage::RGB) {
+}
+
+int RenderSession::add_object(Model &model, const mat4 &transform, TGAColor color)
+{
+  Object object;
+  object.model = &model;
+  object.transform = transform;
+  object.color = color;
+  object.first_triangle = int(triangle_color_.size());
+  for (auto i = 0; i < model.nfaces(); i++) {
+    auto face = model.face(i);
+    object.faces.push_back(vec3i(face[0], face[1], face[2]));
+  }
+  update_geometry(object);
+  mark_tiles(dirty_tiles_, object.tile_min, object.tile_max);
+  triangle_color_.resize(triangle_color_.size() + object.faces.size());
+  objects_.push_back(object);
+  update_colors(objects_.back());
+  return int(objects_.size()) - 1;
+}
+
+void RenderSession::set_transform(int id, const mat4 &transform)
+{
+  auto &object = objects_[id];
+  mark_tiles(dirty_tiles_, object.tile_min, object.tile_max);
+  object.transform = transform;
+  update_geometry(object);
+  mark_tiles(dirty_tiles_, object.tile_min, object.tile_max);
+  update_colors(object);
+}
+
+void RenderSession::set_color(int id, TGAColor color)
+{
+  auto &object = objects_[id];
+  object.color = color;
+  update_colors(object);
+  // Only the object's pixels change colour, and they all lie in its tiles.
+  mark_tiles(stale_tiles_, object.tile_min, object.tile_max);
+}
+
+void RenderSession::set_light(vec3 light_dir)
+{
+  light_dir_ = light_dir;
+  for (auto &object : objects_) {
+    update_colors(object);
+  }
+  reshade_all_ = true;
+}
+
+void RenderSession::invalidate()
+{
+  fill(dirty_tiles_.begin(), dirty_tiles_.end(), 1);
+}
+
+int RenderSession::triangle_at(int x, int y) const
+{
+  return ids_[y * width_ + x];
+}
+
+TGAImage &RenderSession::image()
+{
+  return image_;
+}
+
+void RenderSession::update_geometry(Object &object)
+{
+  auto &model = *object.model;
+  auto nverts = model.nverts();
+  vector<vec3> verts(nverts);
+  for (auto i = 0; i < nverts; i++) {
+    verts[i] = model.vert(i);
+  }
+  object.world.resize(nverts);
+  object.screen.resize(nverts);
+  transform_points(object.transform, verts.data(), object.world.data(), nverts);
+
+  vec2 lo(numeric_limits<float>::max(), numeric_limits<float>::max());
+  vec2 hi(-numeric_limits<float>::max(), -numeric_limits<float>::max());
+  for (auto i = 0; i < nverts; i++) {
+    auto &s = object.screen[i] = world2screen(object.world[i], width_, height_);
+    lo = vec2(min(lo.x, s.x), min(lo.y, s.y));
+    hi = vec2(max(hi.x, s.x), max(hi.y, s.y));
+  }
+  object.tile_min = vec2i(max(0, int(lo.x) / tile_size), max(0, int(lo.y) / tile_size));
+  object.tile_max = vec2i(min(tiles_x_ - 1, int(hi.x) / tile_size), min(tiles_y_ - 1, int(hi.y) / tile_size));
+
+  object.normals.resize(object.faces.size());
+  for (size_t i = 0; i < object.faces.size(); i++) {
+    auto &f = object.faces[i];
+    object.normals[i] = normalize((object.world[f.z] - object.world[f.x]) ^ (object.world[f.y] - object.world[f.x]));
+  }
+}
+
+void RenderSession::update_colors(const Object &object)
+{
+  for (size_t i = 0; i < object.faces.size(); i++) {
+    auto intensity = max(0.f, object.normals[i] * light_dir_);
+    triangle_color_[object.first_triangle + i] = TGAColor(object.color) * intensity;
+  }
+}
+
+void RenderSession::mark_tiles(vector<char> &tiles, const vec2i &tile_min, const vec2i &tile_max)
+{
+  for (auto ty = tile_min.y; ty <= tile_max.y; ty++) {
+    for (auto tx = tile_min.x; tx <= tile_max.x; tx++) {
+      tiles[ty * tiles_x_ + tx] = 1;
+    }
+  }
+}
+
+void RenderSession::rasterize_tile(int tx, int ty, SessionStats &stats)
+{
+  const auto view_dir = vec3(0, 0, -1);
+  vec2i clip_min(tx * tile_size, ty * tile_size);
+  vec2i clip_max(min(clip_min.x + tile_size, width_) - 1, min(clip_min.y + tile_size, height_) - 1);
+  for (auto y = clip_min.y; y <= clip_max.y; y++) {
+    fill_n(zbuffer_.begin() + y * width_ + clip_min.x, clip_max.x - clip_min.x + 1, -numeric_limits<float>::max());
+    fill_n(ids_.begin() + y * width_ + clip_min.x, clip_max.x - clip_min.x + 1, -1);
+  }
+
+  for (auto &object : objects_) {
+    if (tx < object.tile_min.x || tx > object.tile_max.x || ty < object.tile_min.y || ty > object.tile_max.y) {
+      continue;
+    }
+    for (size_t i = 0; i < object.faces.size(); i++) {
+      if (object.normals[i] * view_dir <= 0) continue;
+      auto &f = object.faces[i];
+      vec3 pts[3] = {object.screen[f.x], object.screen[f.y], object.screen[f.z]};
+      if (max({pts[0].x, pts[1].x, pts[2].x}) < clip_min.x || min({pts[0].x, pts[1].x, pts[2].x}) > clip_max.x ||
+          max({pts[0].y, pts[1].y, pts[2].y}) < clip_min.y || min({pts[0].y, pts[1].y, pts[2].y}) > clip_max.y) {
+        continue;
+      }
+      auto id = object.first_triangle + int(i);
+      stats.triangles_rasterized++;
+      rasterize(pts, zbuffer_.data(), width_, clip_min, clip_max, [&](int x, int y, const vec3 &) {
+        ids_[y * width_ + x] = id;
+      });
+    }
+  }
+  stats.tiles_rasterized++;
+}
+
+void RenderSession::shade_rect(int x0, int y0, int x1, int y1, SessionStats &stats)
+{
+  auto bytespp = image_.get_bytespp();
+  auto data = image_.buffer();
+  for (auto y = y0; y < y1; y++) {
+    for (auto x = x0; x < x1; x++) {
+      auto id = ids_[y * width_ + x];
+      auto color = id < 0 ? TGAColor(0, 0, 0, 255) : triangle_color_[id];
+      memcpy(data + (y * width_ + x) * bytespp, color.raw, bytespp);
+    }
+  }
+  stats.pixels_shaded += (x1 - x0) * (y1 - y0);
+}
+
+SessionStats RenderSession::render()
+{
+  SessionStats stats{0, 0, 0};
+  for (auto ty = 0; ty < tiles_y_; ty++) {
+    for (auto tx = 0; tx < tiles_x_; tx++) {
+      auto &dirty = dirty_tiles_[ty * tiles_x_ + tx], &stale = stale_tiles_[ty * tiles_x_ + tx];
+      if (!dirty && !stale) continue;
+      if (dirty) {
+        rasterize_tile(tx, ty, stats);
+      }
+      if (!reshade_all_) {
+        shade_rect(tx * tile_size, ty * tile_size, min((tx + 1) * tile_size, width_),
+                   min((ty + 1) * tile_size, height_), stats);
+      }
+      dirty = stale = 0;
+    }
+  }
+  if (reshade_all_) {
+    shade_rect(0, 0, width_, height_, stats);
+    reshade_all_ = false;
+  }
+  return stats;
+}
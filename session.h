@@ -0,0 +1,74 @@
+#ifndef __SESSION_H__
+#define __SESSION_H__
+
+#include <vector>
+#include "tgaimage.h"
+#include "model.h"
+#include "vec.h"
+
+using namespace std;
+
+struct SessionStats {
+	int tiles_rasterized;
+	int triangles_rasterized;
+	int pixels_shaded;
+};
+
+// Retained-mode renderer. Keeps each object's transformed vertices and a
+// visibility buffer (triangle id and depth per pixel) between frames, and
+// on render() redoes only what the edits since the last frame invalidated:
+//  - set_light() re-shades the whole image and set_color() the object's
+//    tiles, from the visibility buffer and without rasterizing anything;
+//  - set_transform() re-rasterizes only the screen tiles the object covered
+//    before or covers after the move.
+// Models are borrowed and must outlive the session. Shading matches
+// draw_model(): flat, view along -z, back faces skipped.
+class RenderSession {
+private:
+	struct Object {
+		Model *model;
+		mat4 transform;
+		TGAColor color;
+		int first_triangle;
+		vector<vec3i> faces;
+		vector<vec3> world;
+		vector<vec3> screen;
+		vector<vec3> normals;
+		vec2i tile_min, tile_max;
+	};
+
+	int width_, height_;
+	int tiles_x_, tiles_y_;
+	vec3 light_dir_;
+	vector<Object> objects_;
+	vector<TGAColor> triangle_color_; // per triangle id
+	vector<float> zbuffer_;
+	vector<int> ids_;
+	vector<char> dirty_tiles_; // re-rasterize and re-shade
+	vector<char> stale_tiles_; // re-shade only
+	bool reshade_all_;
+	TGAImage image_;
+
+	void update_geometry(Object &object);
+	void update_colors(const Object &object);
+	void mark_tiles(vector<char> &tiles, const vec2i &tile_min, const vec2i &tile_max);
+	void rasterize_tile(int tx, int ty, SessionStats &stats);
+	void shade_rect(int x0, int y0, int x1, int y1, SessionStats &stats);
+public:
+	static const int tile_size = 32;
+
+	RenderSession(int width, int height, vec3 light_dir = vec3(0, 0, -1));
+	// Returns the object's id.
+	int add_object(Model &model, const mat4 &transform, TGAColor color);
+	void set_transform(int id, const mat4 &transform);
+	void set_color(int id, TGAColor color);
+	void set_light(vec3 light_dir);
+	// Forces the next render() to redo every tile.
+	void invalidate();
+	SessionStats render();
+	// Triangle id (object first_triangle + face) at a pixel, or -1.
+	int triangle_at(int x, int y) const;
+	TGAImage &image();
+};
+
+#endif //__SESSION_H__
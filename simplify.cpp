@@ -0,0 +1,271 @@
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <queue>
+#include <vector>
+#include "simplify.h"
+
+using namespace std;
+
+namespace {
+
+// Symmetric 4x4 matrix, upper triangle in row order.
+struct Quadric {
+  double q[10];
+
+  Quadric() : q{} {}
+
+  // Squared distance to the plane ax + by + cz + d = 0, times weight.
+  Quadric(double a, double b, double c, double d, double weight) {
+    double p[4] = {a, b, c, d};
+    int k = 0;
+    for (int i = 0; i < 4; i++)
+      for (int j = i; j < 4; j++)
+        q[k++] = p[i] * p[j] * weight;
+  }
+
+  Quadric &operator +=(const Quadric &o) {
+    for (int i = 0; i < 10; i++) q[i] += o.q[i];
+    return *this;
+  }
+
+  Quadric operator +(const Quadric &o) const {
+    Quadric r = *this;
+    return r += o;
+  }
+
+  double error(const vec3d &v) const {
+    return q[0] * v.x * v.x + 2 * q[1] * v.x * v.y + 2 * q[2] * v.x * v.z + 2 * q[3] * v.x
+         + q[4] * v.y * v.y + 2 * q[5] * v.y * v.z + 2 * q[6] * v.y
+         + q[7] * v.z * v.z + 2 * q[8] * v.z
+         + q[9];
+  }
+
+  // Point minimizing error(), if the 3x3 part is well conditioned.
+  bool minimum(vec3d &v) const {
+    Mat<double, 3> a;
+    a[0][0] = q[0]; a[0][1] = q[1]; a[0][2] = q[2];
+    a[1][0] = q[1]; a[1][1] = q[4]; a[1][2] = q[5];
+    a[2][0] = q[2]; a[2][1] = q[5]; a[2][2] = q[7];
+    auto det = determinant(a);
+    auto scale = q[0] * q[4] * q[7];
+    if (abs(det) <= 1e-12 * max(abs(scale), 1e-30)) return false;
+    v = inverse(a) * vec3d(-q[3], -q[6], -q[8]);
+    return true;
+  }
+};
+
+struct Collapse {
+  double cost;
+  int u, v;
+  int stamp_u, stamp_v;
+  vec3d target;
+
+  bool operator <(const Collapse &o) const { return cost > o.cost; } // min-heap
+};
+
+class Simplifier {
+private:
+  vector<vec3d> pos_;
+  vector<Quadric> quadrics_;
+  vector<vec3i> faces_;
+  vector<char> face_alive_;
+  vector<char> vert_alive_;
+  vector<int> stamp_;
+  vector<vector<int> > vert_faces_;
+  priority_queue<Collapse> heap_;
+  int live_faces_;
+
+  vec3d face_normal(const vec3i &f) const {
+    return (pos_[f.y] - pos_[f.x]) ^ (pos_[f.z] - pos_[f.x]);
+  }
+
+  void push(int u, int v) {
+    auto q = quadrics_[u] + quadrics_[v];
+    Collapse c;
+    c.u = u;
+    c.v = v;
+    c.stamp_u = stamp_[u];
+    c.stamp_v = stamp_[v];
+    if (!q.minimum(c.target)) {
+      c.target = pos_[u];
+      for (auto &p : {pos_[v], (pos_[u] + pos_[v]) * .5}) {
+        if (q.error(p) < q.error(c.target)) c.target = p;
+      }
+    }
+    c.cost = max(0., q.error(c.target));
+    heap_.push(c);
+  }
+
+  void neighbours(int u, vector<int> &out) const {
+    out.clear();
+    for (auto f : vert_faces_[u]) {
+      for (auto w : {faces_[f].x, faces_[f].y, faces_[f].z}) {
+        if (w != u) out.push_back(w);
+      }
+    }
+    sort(out.begin(), out.end());
+    out.erase(unique(out.begin(), out.end()), out.end());
+  }
+
+  // Manifold-preserving and no triangle turns over.
+  bool legal(const Collapse &c) {
+    vector<int> nu, nv;
+    neighbours(c.u, nu);
+    neighbours(c.v, nv);
+    vector<int> common;
+    set_intersection(nu.begin(), nu.end(), nv.begin(), nv.end(), back_inserter(common));
+    int shared = 0;
+    for (auto f : vert_faces_[c.u]) {
+      auto &t = faces_[f];
+      shared += t.x == c.v || t.y == c.v || t.z == c.v;
+    }
+    if ((int)common.size() != shared) return false;
+
+    for (auto w : {c.u, c.v}) {
+      for (auto f : vert_faces_[w]) {
+        auto t = faces_[f];
+        if ((t.x == c.u || t.y == c.u || t.z == c.u) && (t.x == c.v || t.y == c.v || t.z == c.v)) continue;
+        auto before = face_normal(t);
+        auto saved = pos_[w];
+        pos_[w] = c.target;
+        auto after = face_normal(t);
+        pos_[w] = saved;
+        if (before * after <= 0) return false;
+      }
+    }
+    return true;
+  }
+
+  void collapse(const Collapse &c) {
+    pos_[c.u] = c.target;
+    quadrics_[c.u] += quadrics_[c.v];
+    vector<int> touched{c.u};
+    for (auto f : vert_faces_[c.v]) {
+      auto &t = faces_[f];
+      if (t.x == c.u || t.y == c.u || t.z == c.u) {
+        face_alive_[f] = 0;
+        live_faces_--;
+        for (auto w : {t.x, t.y, t.z}) touched.push_back(w);
+        continue;
+      }
+      if (t.x == c.v) t.x = c.u;
+      if (t.y == c.v) t.y = c.u;
+      if (t.z == c.v) t.z = c.u;
+      vert_faces_[c.u].push_back(f);
+    }
+    vert_faces_[c.v].clear();
+    vert_alive_[c.v] = 0;
+    stamp_[c.u]++;
+
+    // Only u and the far corners of the two removed faces can still list a
+    // dead face.
+    for (auto w : touched) {
+      auto &faces = vert_faces_[w];
+      faces.erase(remove_if(faces.begin(), faces.end(), [&](int f) { return !face_alive_[f]; }), faces.end());
+    }
+    vector<int> around;
+    neighbours(c.u, around);
+    for (auto w : around) push(c.u, w);
+  }
+
+public:
+  Simplifier(Model &model) : live_faces_(0) {
+    auto nverts = model.nverts();
+    pos_.resize(nverts);
+    for (int i = 0; i < nverts; i++) {
+      pos_[i] = vec3d(model.vert(i));
+    }
+    for (int i = 0; i < model.nfaces(); i++) {
+      auto &f = model.face(i);
+      for (size_t j = 2; j < f.size(); j++) {
+        faces_.push_back(vec3i(f[0], f[j - 1], f[j]));
+      }
+    }
+    face_alive_.assign(faces_.size(), 1);
+    vert_alive_.assign(nverts, 1);
+    stamp_.assign(nverts, 0);
+    quadrics_.resize(nverts);
+    vert_faces_.resize(nverts);
+    live_faces_ = (int)faces_.size();
+
+    map<pair<int, int>, int> edge_faces;
+    for (size_t i = 0; i < faces_.size(); i++) {
+      auto &f = faces_[i];
+      auto n = face_normal(f);
+      auto area = n.length();
+      if (area > 0) {
+        n = n / area;
+        Quadric q(n.x, n.y, n.z, -(n * pos_[f.x]), area);
+        for (auto v : {f.x, f.y, f.z}) quadrics_[v] += q;
+      }
+      for (auto v : {f.x, f.y, f.z}) vert_faces_[v].push_back((int)i);
+      for (int j = 0; j < 3; j++) {
+        int a = f[j], b = f[(j + 1) % 3];
+        edge_faces[make_pair(min(a, b), max(a, b))]++;
+      }
+    }
+
+    // Pin open boundaries with heavily weighted planes through each border
+    // edge, perpendicular to its face.
+    for (auto &f : faces_) {
+      auto n = face_normal(f);
+      if (n.norm2() == 0) continue;
+      n = n.normalized();
+      for (int j = 0; j < 3; j++) {
+        int a = f[j], b = f[(j + 1) % 3];
+        if (edge_faces[make_pair(min(a, b), max(a, b))] != 1) continue;
+        auto edge = pos_[b] - pos_[a];
+        auto p = edge ^ n;
+        if (p.norm2() == 0) continue;
+        p = p.normalized();
+        Quadric q(p.x, p.y, p.z, -(p * pos_[a]), 1000 * edge.norm2());
+        quadrics_[a] += q;
+        quadrics_[b] += q;
+      }
+    }
+
+    for (auto &e : edge_faces) {
+      push(e.first.first, e.first.second);
+    }
+  }
+
+  void run(int target_faces) {
+    while (live_faces_ > target_faces && !heap_.empty()) {
+      auto c = heap_.top();
+      heap_.pop();
+      if (!vert_alive_[c.u] || !vert_alive_[c.v]) continue;
+      if (stamp_[c.u] != c.stamp_u || stamp_[c.v] != c.stamp_v) continue;
+      if (!legal(c)) continue;
+      collapse(c);
+    }
+  }
+
+  Model result() const {
+    vector<int> remap(pos_.size(), -1);
+    vector<vec3> verts;
+    vector<vector<int> > faces;
+    for (size_t i = 0; i < faces_.size(); i++) {
+      if (!face_alive_[i]) continue;
+      vector<int> f;
+      for (auto v : {faces_[i].x, faces_[i].y, faces_[i].z}) {
+        if (remap[v] < 0) {
+          remap[v] = (int)verts.size();
+          verts.push_back(vec3(pos_[v]));
+        }
+        f.push_back(remap[v]);
+      }
+      faces.push_back(f);
+    }
+    return Model(verts, faces);
+  }
+};
+
+} // namespace
+
+Model simplify(Model &model, int target_faces)
+{
+  Simplifier simplifier(model);
+  simplifier.run(target_faces);
+  return simplifier.result();
+}
@@ -0,0 +1,15 @@
+#ifndef __SIMPLIFY_H__
+#define __SIMPLIFY_H__
+
+#include "model.h"
+
+// Quadric error metric simplification (Garland & Heckbert): collapses the
+// cheapest edge, moving the survivor to the position that minimizes the
+// summed squared distance to the original planes around both endpoints,
+// until the mesh has at most target_faces triangles or no legal collapse is
+// left. Open boundaries are held in place by extra perpendicular planes;
+// collapses that would fold a triangle over or pinch the surface into a
+// non-manifold are skipped.
+Model simplify(Model &model, int target_faces);
+
+#endif //__SIMPLIFY_H__
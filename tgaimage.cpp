@@ -146,9 +146,11 @@ bool TGAImage::load_rle_data(std::ifstream &in) {
 }
 
 bool TGAImage::write_tga_file(const char *filename, bool rle) {
-	unsigned char developer_area_ref[4] = {0, 0, 0, 0};
-	unsigned char extension_area_ref[4] = {0, 0, 0, 0};
-	unsigned char footer[18] = {'T','R','U','E','V','I','S','I','O','N','-','X','F','I','L','E','.','\0'};
+	std::vector<unsigned char> bytes;
+	if (!encode_tga(bytes, rle)) {
+		std::cerr << "can't dump the tga file\n";
+		return false;
+	}
 	std::ofstream out;
 	out.open (filename, std::ios::binary);
 	if (!out.is_open()) {
@@ -156,6 +158,21 @@ bool TGAImage::write_tga_file(const char *filename, bool rle) {
 		out.close();
 		return false;
 	}
+	out.write((char *)bytes.data(), bytes.size());
+	if (!out.good()) {
+		std::cerr << "can't dump the tga file\n";
+		out.close();
+		return false;
+	}
+	out.close();
+	return true;
+}
+
+bool TGAImage::encode_tga(std::vector<unsigned char> &out, bool rle) {
+	unsigned char developer_area_ref[4] = {0, 0, 0, 0};
+	unsigned char extension_area_ref[4] = {0, 0, 0, 0};
+	unsigned char footer[18] = {'T','R','U','E','V','I','S','I','O','N','-','X','F','I','L','E','.','\0'};
+	if (!data) return false;
 	TGA_Header header;
 	memset((void *)&header, 0, sizeof(header));
 	header.bitsperpixel = bytespp<<3;
@@ -163,50 +180,21 @@ bool TGAImage::write_tga_file(const char *filename, bool rle) {
 	header.height = height;
 	header.datatypecode = (bytespp==GRAYSCALE?(rle?11:3):(rle?10:2));
 	header.imagedescriptor = 0x20; // top-left origin
-	out.write((char *)&header, sizeof(header));
-	if (!out.good()) {
-		out.close();
-		std::cerr << "can't dump the tga file\n";
-		return false;
-	}
+	out.clear();
+	out.insert(out.end(), (unsigned char *)&header, (unsigned char *)&header + sizeof(header));
 	if (!rle) {
-		out.write((char *)data, width*height*bytespp);
-		if (!out.good()) {
-			std::cerr << "can't unload raw data\n";
-			out.close();
-			return false;
-		}
+		out.insert(out.end(), data, data + width*height*bytespp);
 	} else {
-		if (!unload_rle_data(out)) {
-			out.close();
-			std::cerr << "can't unload rle data\n";
-			return false;
-		}
-	}
-	out.write((char *)developer_area_ref, sizeof(developer_area_ref));
-	if (!out.good()) {
-		std::cerr << "can't dump the tga file\n";
-		out.close();
-		return false;
-	}
-	out.write((char *)extension_area_ref, sizeof(extension_area_ref));
-	if (!out.good()) {
-		std::cerr << "can't dump the tga file\n";
-		out.close();
-		return false;
-	}
-	out.write((char *)footer, sizeof(footer));
-	if (!out.good()) {
-		std::cerr << "can't dump the tga file\n";
-		out.close();
-		return false;
+		unload_rle_data(out);
 	}
-	out.close();
+	out.insert(out.end(), developer_area_ref, developer_area_ref + sizeof(developer_area_ref));
+	out.insert(out.end(), extension_area_ref, extension_area_ref + sizeof(extension_area_ref));
+	out.insert(out.end(), footer, footer + sizeof(footer));
 	return true;
 }
 
 // TODO: it is not necessary to break a raw chunk for two equal pixels (for the matter of the resulting size)
-bool TGAImage::unload_rle_data(std::ofstream &out) {
+void TGAImage::unload_rle_data(std::vector<unsigned char> &out) {
 	const unsigned char max_chunk_length = 128;
 	unsigned long npixels = width*height;
 	unsigned long curpix = 0;
@@ -234,18 +222,9 @@ bool TGAImage::unload_rle_data(std::ofstream &out) {
 			run_length++;
 		}
 		curpix += run_length;
-		out.put(raw?run_length-1:run_length+127);
-		if (!out.good()) {
-			std::cerr << "can't dump the tga file\n";
-			return false;
-		}
-		out.write((char *)(data+chunkstart), (raw?run_length*bytespp:bytespp));
-		if (!out.good()) {
-			std::cerr << "can't dump the tga file\n";
-			return false;
-		}
+		out.push_back(raw?run_length-1:run_length+127);
+		out.insert(out.end(), data+chunkstart, data+chunkstart+(raw?run_length*bytespp:bytespp));
 	}
-	return true;
 }
 
 TGAColor TGAImage::get(int x, int y) {
@@ -2,6 +2,7 @@
 #define __IMAGE_H__
 
 #include <fstream>
+#include <vector>
 
 #pragma pack(push,1)
 struct TGA_Header {
@@ -72,7 +73,7 @@ protected:
 	int bytespp;
 
 	bool   load_rle_data(std::ifstream &in);
-	bool unload_rle_data(std::ofstream &out);
+	void unload_rle_data(std::vector<unsigned char> &out);
 public:
 	enum Format {
 		GRAYSCALE=1, RGB=3, RGBA=4
@@ -83,6 +84,8 @@ public:
 	TGAImage(const TGAImage &img);
 	bool read_tga_file(const char *filename);
 	bool write_tga_file(const char *filename, bool rle=true);
+	// Same bytes as write_tga_file(), into memory (replacing out's contents).
+	bool encode_tga(std::vector<unsigned char> &out, bool rle=true);
 	bool flip_horizontally();
 	bool flip_vertically();
 	bool scale(int w, int h);
@@ -1,55 +1,81 @@
 #ifndef __VEC_H__
 #define __VEC_H__
 
+#include <algorithm>
 #include <cmath>
+#include <cstddef>
 
 using namespace std;
 
-template <class T> class Vec3 {
+template <class T> class Vec2 {
   public:
-    T x, y, z;
+    T x, y;
 
-    Vec3() { x = y = z = 0; };
+    constexpr Vec2() : x(0), y(0) {}
 
-    Vec3(T x_, T y_, T z_)
-    {
-      x = x_;
-      y = y_;
-      z = z_;
-    }
+    constexpr Vec2(T x_, T y_) : x(x_), y(y_) {}
 
-    constexpr T length()
+    template <class U> constexpr explicit Vec2(const Vec2<U> &v) : x(T(v.x)), y(T(v.y)) {}
+
+    constexpr T operator [](int i) const
     {
-      return sqrt(x * x + y * y + z * z);
+      constexpr T Vec2::*m[] = {&Vec2::x, &Vec2::y};
+      return this->*m[i];
     }
 
-    T normalize()
+    constexpr T &operator [](int i)
     {
-      auto l = length();
-      x /= l;
-      y /= l;
-      z /= l;
-      return l;
+      constexpr T Vec2::*m[] = {&Vec2::x, &Vec2::y};
+      return this->*m[i];
     }
 
-    constexpr Vec3<T> operator +(const Vec3<T> &v)
+    constexpr Vec2<T> operator +(const Vec2<T> &v) const { return Vec2<T>(x + v.x, y + v.y); }
+    constexpr Vec2<T> operator -(const Vec2<T> &v) const { return Vec2<T>(x - v.x, y - v.y); }
+    constexpr Vec2<T> operator -() const { return Vec2<T>(-x, -y); }
+    constexpr Vec2<T> operator *(T s) const { return Vec2<T>(x * s, y * s); }
+    constexpr Vec2<T> operator /(T s) const { return Vec2<T>(x / s, y / s); }
+
+    // Dot product
+    constexpr T operator *(const Vec2<T> &v) const { return x * v.x + y * v.y; }
+
+    constexpr T norm2() const { return x * x + y * y; }
+    T length() const { return sqrt(norm2()); }
+};
+
+template <class T> class Vec3 {
+  public:
+    T x, y, z;
+
+    constexpr Vec3() : x(0), y(0), z(0) {}
+
+    constexpr Vec3(T x_, T y_, T z_) : x(x_), y(y_), z(z_) {}
+
+    template <class U> constexpr explicit Vec3(const Vec3<U> &v) : x(T(v.x)), y(T(v.y)), z(T(v.z)) {}
+
+    // Indexing goes through a member table rather than a branch chain, so a
+    // constant index folds away and a variable one is a single load.
+    constexpr T operator [](int i) const
     {
-      return Vec3<T>(x + v.x, y + v.y, z + v.z);
+      constexpr T Vec3::*m[] = {&Vec3::x, &Vec3::y, &Vec3::z};
+      return this->*m[i];
     }
 
-    constexpr Vec3<T> operator -(const Vec3<T> &v)
+    constexpr T &operator [](int i)
     {
-      return Vec3<T>(x - v.x, y - v.y, z - v.z);
+      constexpr T Vec3::*m[] = {&Vec3::x, &Vec3::y, &Vec3::z};
+      return this->*m[i];
     }
 
+    constexpr Vec3<T> operator +(const Vec3<T> &v) const { return Vec3<T>(x + v.x, y + v.y, z + v.z); }
+    constexpr Vec3<T> operator -(const Vec3<T> &v) const { return Vec3<T>(x - v.x, y - v.y, z - v.z); }
+    constexpr Vec3<T> operator -() const { return Vec3<T>(-x, -y, -z); }
+
     // Scalar product
-    constexpr Vec3<T> operator *(const T &v)
-    {
-      return Vec3<T>(x * v, y * v, z * v);
-    }
+    constexpr Vec3<T> operator *(T s) const { return Vec3<T>(x * s, y * s, z * s); }
+    constexpr Vec3<T> operator /(T s) const { return Vec3<T>(x / s, y / s, z / s); }
 
     // Cross product
-    constexpr Vec3<T> operator ^(const Vec3<T> &v)
+    constexpr Vec3<T> operator ^(const Vec3<T> &v) const
     {
       return Vec3<T>(
           y * v.z - z * v.y,
@@ -58,40 +84,338 @@ template <class T> class Vec3 {
     }
 
     // Dot product
-    constexpr T operator *(const Vec3<T> &v)
+    constexpr T operator *(const Vec3<T> &v) const { return x * v.x + y * v.y + z * v.z; }
+
+    constexpr Vec3<T> &operator +=(const Vec3<T> &v) { x += v.x; y += v.y; z += v.z; return *this; }
+    constexpr Vec3<T> &operator -=(const Vec3<T> &v) { x -= v.x; y -= v.y; z -= v.z; return *this; }
+    constexpr Vec3<T> &operator *=(T s) { x *= s; y *= s; z *= s; return *this; }
+
+    constexpr T norm2() const { return x * x + y * y + z * z; }
+    T length() const { return sqrt(norm2()); }
+
+    T normalize()
     {
-      return x * v.x + y * v.y + z * v.z;
+      auto l = length();
+      *this *= T(1) / l;
+      return l;
     }
 
-    constexpr Vec3<T> operator /(const T &v)
+    Vec3<T> normalized() const { return *this * (T(1) / length()); }
+};
+
+template <class T> class Vec4 {
+  public:
+    T x, y, z, w;
+
+    constexpr Vec4() : x(0), y(0), z(0), w(0) {}
+
+    constexpr Vec4(T x_, T y_, T z_, T w_) : x(x_), y(y_), z(z_), w(w_) {}
+
+    constexpr Vec4(const Vec3<T> &v, T w_) : x(v.x), y(v.y), z(v.z), w(w_) {}
+
+    constexpr T operator [](int i) const
     {
-      return Vec3<T>(x / v, y / v, z / v);
+      constexpr T Vec4::*m[] = {&Vec4::x, &Vec4::y, &Vec4::z, &Vec4::w};
+      return this->*m[i];
     }
 
-    constexpr T operator [](const int &i)
+    constexpr T &operator [](int i)
     {
-      if (i == 0) return x;
-      else if (i == 1) return y;
-      else return z;
+      constexpr T Vec4::*m[] = {&Vec4::x, &Vec4::y, &Vec4::z, &Vec4::w};
+      return this->*m[i];
     }
+
+    constexpr Vec3<T> xyz() const { return Vec3<T>(x, y, z); }
+
+    // Perspective divide
+    constexpr Vec3<T> project() const { return Vec3<T>(x / w, y / w, z / w); }
+
+    constexpr Vec4<T> operator +(const Vec4<T> &v) const { return Vec4<T>(x + v.x, y + v.y, z + v.z, w + v.w); }
+    constexpr Vec4<T> operator -(const Vec4<T> &v) const { return Vec4<T>(x - v.x, y - v.y, z - v.z, w - v.w); }
+    constexpr Vec4<T> operator *(T s) const { return Vec4<T>(x * s, y * s, z * s, w * s); }
+
+    // Dot product
+    constexpr T operator *(const Vec4<T> &v) const { return x * v.x + y * v.y + z * v.z + w * v.w; }
 };
 
-template <class T> class Vec2 {
+template <class T> constexpr Vec3<T> cross(const Vec3<T> &a, const Vec3<T> &b) { return a ^ b; }
+template <class T> constexpr T dot(const Vec2<T> &a, const Vec2<T> &b) { return a * b; }
+template <class T> constexpr T dot(const Vec3<T> &a, const Vec3<T> &b) { return a * b; }
+template <class T> constexpr T dot(const Vec4<T> &a, const Vec4<T> &b) { return a * b; }
+template <class T> Vec3<T> normalize(const Vec3<T> &v) { return v.normalized(); }
+
+// Row-major N x N matrix; m[row][col].
+template <class T, int N> class Mat {
   public:
-    T x, y;
+    T m[N][N];
+
+    constexpr Mat() : m{} {}
+
+    static constexpr Mat identity()
+    {
+      Mat r;
+      for (int i = 0; i < N; i++) r.m[i][i] = T(1);
+      return r;
+    }
 
-    Vec2() { x = y = 0; }
+    constexpr const T *operator [](int row) const { return m[row]; }
+    constexpr T *operator [](int row) { return m[row]; }
 
-    Vec2(T x_, T y_)
+    constexpr Mat operator *(const Mat &b) const
     {
-      x = x_;
-      y = y_;
+      Mat r;
+      for (int i = 0; i < N; i++)
+        for (int k = 0; k < N; k++)
+          for (int j = 0; j < N; j++)
+            r.m[i][j] += m[i][k] * b.m[k][j];
+      return r;
+    }
+
+    constexpr Mat transpose() const
+    {
+      Mat r;
+      for (int i = 0; i < N; i++)
+        for (int j = 0; j < N; j++)
+          r.m[j][i] = m[i][j];
+      return r;
+    }
+};
+
+template <class T> constexpr Vec3<T> operator *(const Mat<T, 3> &a, const Vec3<T> &v)
+{
+  return Vec3<T>(
+      a.m[0][0] * v.x + a.m[0][1] * v.y + a.m[0][2] * v.z,
+      a.m[1][0] * v.x + a.m[1][1] * v.y + a.m[1][2] * v.z,
+      a.m[2][0] * v.x + a.m[2][1] * v.y + a.m[2][2] * v.z);
+}
+
+template <class T> constexpr Vec4<T> operator *(const Mat<T, 4> &a, const Vec4<T> &v)
+{
+  return Vec4<T>(
+      a.m[0][0] * v.x + a.m[0][1] * v.y + a.m[0][2] * v.z + a.m[0][3] * v.w,
+      a.m[1][0] * v.x + a.m[1][1] * v.y + a.m[1][2] * v.z + a.m[1][3] * v.w,
+      a.m[2][0] * v.x + a.m[2][1] * v.y + a.m[2][2] * v.z + a.m[2][3] * v.w,
+      a.m[3][0] * v.x + a.m[3][1] * v.y + a.m[3][2] * v.z + a.m[3][3] * v.w);
+}
+
+// Transform a point (w = 1) and divide through by the resulting w.
+template <class T> constexpr Vec3<T> transform_point(const Mat<T, 4> &a, const Vec3<T> &p)
+{
+  return (a * Vec4<T>(p, T(1))).project();
+}
+
+// Transform a direction (w = 0); translation is ignored.
+template <class T> constexpr Vec3<T> transform_dir(const Mat<T, 4> &a, const Vec3<T> &d)
+{
+  return (a * Vec4<T>(d, T(0))).xyz();
+}
+
+// Half-extents of the axis-aligned box around a sphere of radius r after
+// an affine transform. The sphere maps to an ellipsoid whose extent along
+// axis i is r times the length of row i of the linear part; unlike a scalar
+// scale this stays tight (and correct) under shear.
+template <class T> Vec3<T> sphere_extent(const Mat<T, 4> &a, T r)
+{
+  Vec3<T> e;
+  for (int i = 0; i < 3; i++) {
+    e[i] = r * Vec3<T>(a.m[i][0], a.m[i][1], a.m[i][2]).length();
+  }
+  return e;
+}
+
+template <class T> constexpr T determinant(const Mat<T, 3> &a)
+{
+  return a.m[0][0] * (a.m[1][1] * a.m[2][2] - a.m[1][2] * a.m[2][1])
+       - a.m[0][1] * (a.m[1][0] * a.m[2][2] - a.m[1][2] * a.m[2][0])
+       + a.m[0][2] * (a.m[1][0] * a.m[2][1] - a.m[1][1] * a.m[2][0]);
+}
+
+template <class T> constexpr Mat<T, 3> inverse(const Mat<T, 3> &a)
+{
+  Mat<T, 3> r;
+  auto inv_det = T(1) / determinant(a);
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      int i1 = (j + 1) % 3, i2 = (j + 2) % 3;
+      int j1 = (i + 1) % 3, j2 = (i + 2) % 3;
+      r.m[i][j] = (a.m[i1][j1] * a.m[i2][j2] - a.m[i1][j2] * a.m[i2][j1]) * inv_det;
     }
+  }
+  return r;
+}
+
+// Inverse of an affine transform (last row 0 0 0 1).
+template <class T> constexpr Mat<T, 4> inverse_affine(const Mat<T, 4> &a)
+{
+  Mat<T, 3> l;
+  for (int i = 0; i < 3; i++)
+    for (int j = 0; j < 3; j++)
+      l.m[i][j] = a.m[i][j];
+  auto li = inverse(l);
+  auto t = li * Vec3<T>(a.m[0][3], a.m[1][3], a.m[2][3]);
+  auto r = Mat<T, 4>::identity();
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) r.m[i][j] = li.m[i][j];
+    r.m[i][3] = -t[i];
+  }
+  return r;
+}
+
+// SoA packets: N scalars or N vectors processed in lock-step. The loops below
+// have fixed trip counts and no cross-lane dependencies, so they map directly
+// onto SSE (N = 4) or AVX (N = 8) registers. They pay off only for data
+// that is already SoA; for vertex transforms the AoS transform_points() is
+// the fast path (see bench/vec_bench).
+template <class T, int N> class Pack {
+  public:
+    alignas(sizeof(T) * N) T v[N];
+
+    constexpr T operator [](int i) const { return v[i]; }
+    constexpr T &operator [](int i) { return v[i]; }
 };
 
-typedef Vec3<double> vec3;
-typedef Vec2<double> vec2;
+template <class T, int N> class Vec3Pack {
+  public:
+    alignas(sizeof(T) * N) T x[N];
+    alignas(sizeof(T) * N) T y[N];
+    alignas(sizeof(T) * N) T z[N];
+
+    constexpr Vec3<T> get(int i) const { return Vec3<T>(x[i], y[i], z[i]); }
+
+    constexpr void set(int i, const Vec3<T> &p) { x[i] = p.x; y[i] = p.y; z[i] = p.z; }
+
+    void load(const Vec3<T> *src)
+    {
+      for (int i = 0; i < N; i++) set(i, src[i]);
+    }
+
+    void store(Vec3<T> *dst) const
+    {
+      for (int i = 0; i < N; i++) dst[i] = get(i);
+    }
+};
+
+template <class T, int N> Vec3Pack<T, N> operator +(const Vec3Pack<T, N> &a, const Vec3Pack<T, N> &b)
+{
+  Vec3Pack<T, N> r;
+  for (int i = 0; i < N; i++) {
+    r.x[i] = a.x[i] + b.x[i];
+    r.y[i] = a.y[i] + b.y[i];
+    r.z[i] = a.z[i] + b.z[i];
+  }
+  return r;
+}
+
+template <class T, int N> Vec3Pack<T, N> operator -(const Vec3Pack<T, N> &a, const Vec3Pack<T, N> &b)
+{
+  Vec3Pack<T, N> r;
+  for (int i = 0; i < N; i++) {
+    r.x[i] = a.x[i] - b.x[i];
+    r.y[i] = a.y[i] - b.y[i];
+    r.z[i] = a.z[i] - b.z[i];
+  }
+  return r;
+}
+
+template <class T, int N> Vec3Pack<T, N> cross(const Vec3Pack<T, N> &a, const Vec3Pack<T, N> &b)
+{
+  Vec3Pack<T, N> r;
+  for (int i = 0; i < N; i++) {
+    r.x[i] = a.y[i] * b.z[i] - a.z[i] * b.y[i];
+    r.y[i] = a.z[i] * b.x[i] - a.x[i] * b.z[i];
+    r.z[i] = a.x[i] * b.y[i] - a.y[i] * b.x[i];
+  }
+  return r;
+}
+
+template <class T, int N> Pack<T, N> dot(const Vec3Pack<T, N> &a, const Vec3Pack<T, N> &b)
+{
+  Pack<T, N> r;
+  for (int i = 0; i < N; i++) {
+    r.v[i] = a.x[i] * b.x[i] + a.y[i] * b.y[i] + a.z[i] * b.z[i];
+  }
+  return r;
+}
+
+template <class T, int N> Vec3Pack<T, N> normalize(const Vec3Pack<T, N> &a)
+{
+  Vec3Pack<T, N> r;
+  for (int i = 0; i < N; i++) {
+    auto inv = T(1) / sqrt(a.x[i] * a.x[i] + a.y[i] * a.y[i] + a.z[i] * a.z[i]);
+    r.x[i] = a.x[i] * inv;
+    r.y[i] = a.y[i] * inv;
+    r.z[i] = a.z[i] * inv;
+  }
+  return r;
+}
+
+template <class T, int N> Vec3Pack<T, N> transform_point(const Mat<T, 4> &a, const Vec3Pack<T, N> &p)
+{
+  const Mat<T, 4> m = a; // local copy: stores to r cannot alias it
+  Vec3Pack<T, N> r;
+  for (int i = 0; i < N; i++) {
+    auto w = m.m[3][0] * p.x[i] + m.m[3][1] * p.y[i] + m.m[3][2] * p.z[i] + m.m[3][3];
+    auto inv_w = T(1) / w;
+    r.x[i] = (m.m[0][0] * p.x[i] + m.m[0][1] * p.y[i] + m.m[0][2] * p.z[i] + m.m[0][3]) * inv_w;
+    r.y[i] = (m.m[1][0] * p.x[i] + m.m[1][1] * p.y[i] + m.m[1][2] * p.z[i] + m.m[1][3]) * inv_w;
+    r.z[i] = (m.m[2][0] * p.x[i] + m.m[2][1] * p.y[i] + m.m[2][2] * p.z[i] + m.m[2][3]) * inv_w;
+  }
+  return r;
+}
+
+template <class T, int N> Vec3Pack<T, N> transform_dir(const Mat<T, 4> &a, const Vec3Pack<T, N> &d)
+{
+  const Mat<T, 4> m = a; // local copy: stores to r cannot alias it
+  Vec3Pack<T, N> r;
+  for (int i = 0; i < N; i++) {
+    r.x[i] = m.m[0][0] * d.x[i] + m.m[0][1] * d.y[i] + m.m[0][2] * d.z[i];
+    r.y[i] = m.m[1][0] * d.x[i] + m.m[1][1] * d.y[i] + m.m[1][2] * d.z[i];
+    r.z[i] = m.m[2][0] * d.x[i] + m.m[2][1] * d.y[i] + m.m[2][2] * d.z[i];
+  }
+  return r;
+}
+
+// Transform n points from an AoS array. Kept as a flat loop: the compiler
+// already vectorizes it across points, as wide as the target allows, and in
+// vec_bench it runs about twice as fast as the packet overload below.
+template <class T> void transform_points(const Mat<T, 4> &a, const Vec3<T> *in, Vec3<T> *out, size_t n)
+{
+  const Mat<T, 4> m = a;
+  for (size_t i = 0; i < n; i++) {
+    out[i] = transform_point(m, in[i]);
+  }
+}
+
+// Transform n packets already laid out as SoA. The matrix is copied once for
+// the whole array and lanes are written straight into out[i]; in may equal
+// out, since each packet is read in full before it is written.
+template <class T, int N> void transform_points(const Mat<T, 4> &a, const Vec3Pack<T, N> *in, Vec3Pack<T, N> *out, size_t n)
+{
+  const Mat<T, 4> m = a;
+  for (size_t i = 0; i < n; i++) {
+    const Vec3Pack<T, N> p = in[i];
+    auto &r = out[i];
+    for (int k = 0; k < N; k++) {
+      auto w = m.m[3][0] * p.x[k] + m.m[3][1] * p.y[k] + m.m[3][2] * p.z[k] + m.m[3][3];
+      auto inv_w = T(1) / w;
+      r.x[k] = (m.m[0][0] * p.x[k] + m.m[0][1] * p.y[k] + m.m[0][2] * p.z[k] + m.m[0][3]) * inv_w;
+      r.y[k] = (m.m[1][0] * p.x[k] + m.m[1][1] * p.y[k] + m.m[1][2] * p.z[k] + m.m[1][3]) * inv_w;
+      r.z[k] = (m.m[2][0] * p.x[k] + m.m[2][1] * p.y[k] + m.m[2][2] * p.z[k] + m.m[2][3]) * inv_w;
+    }
+  }
+}
+
+typedef Vec2<float> vec2;
+typedef Vec3<float> vec3;
+typedef Vec4<float> vec4;
+typedef Vec3<double> vec3d;
 typedef Vec3<int> vec3i;
 typedef Vec2<int> vec2i;
+typedef Mat<float, 3> mat3;
+typedef Mat<float, 4> mat4;
+typedef Pack<float, 4> floatx4;
+typedef Pack<float, 8> floatx8;
+typedef Vec3Pack<float, 4> vec3x4;
+typedef Vec3Pack<float, 8> vec3x8;
 
 #endif //__VEC_H__
@@ -0,0 +1,314 @@
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include "writer.h"
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+int open_for_write(const string &filename)
+{
+  return open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+}
+
+#ifdef HAVE_IO_URING
+// No liburing: the three system calls and the shared rings are all we need.
+int io_uring_setup(unsigned entries, io_uring_params *params)
+{
+  return int(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+  return int(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+// IORING_OP_WRITE arrived in 5.6, together with the opcode probe. Rings from
+// 5.1-5.5 set up fine and then fail every write with -EINVAL, so a ring that
+// cannot be probed counts as unable to write.
+bool supports_write(int ring_fd)
+{
+#ifdef IO_URING_OP_SUPPORTED // defined alongside the probe API
+  const unsigned nops = 256;
+  vector<unsigned char> buffer(sizeof(io_uring_probe) + nops * sizeof(io_uring_probe_op));
+  auto probe = (io_uring_probe *)buffer.data();
+  if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PROBE, probe, nops) < 0) return false;
+  return probe->last_op >= IORING_OP_WRITE && (probe->ops[IORING_OP_WRITE].flags & IO_URING_OP_SUPPORTED);
+#else
+  return false;
+#endif
+}
+#endif
+
+} // namespace
+
+AsyncWriter::AsyncWriter(int depth, bool use_io_uring)
+  : depth_(max(1, depth)), inflight_(0), failures_(0), bytes_(0), busy_seconds_(0),
+    ring_fd_(-1), sq_ring_(nullptr), cq_ring_(nullptr), sqes_(nullptr),
+    sq_ring_size_(0), cq_ring_size_(0), sqes_size_(0), unsubmitted_(0), closing_(false) {
+  if (use_io_uring && setup_ring()) return;
+  thread_ = thread(&AsyncWriter::run_thread, this);
+}
+
+AsyncWriter::~AsyncWriter()
+{
+  drain();
+#ifdef HAVE_IO_URING
+  if (ring_fd_ >= 0) {
+    munmap(sqes_, sqes_size_);
+    if (cq_ring_ != sq_ring_) munmap(cq_ring_, cq_ring_size_);
+    munmap(sq_ring_, sq_ring_size_);
+    close(ring_fd_);
+    return;
+  }
+#endif
+  {
+    lock_guard<mutex> lock(mutex_);
+    closing_ = true;
+  }
+  changed_.notify_all();
+  thread_.join();
+}
+
+bool AsyncWriter::setup_ring()
+{
+#ifdef HAVE_IO_URING
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  auto fd = io_uring_setup(depth_, &params);
+  if (fd < 0) return false; // old kernel, or io_uring disabled by policy
+  if (!supports_write(fd)) {
+    close(fd);
+    return false;
+  }
+
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  auto single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single) {
+    sq_ring_size_ = cq_ring_size_ = max(sq_ring_size_, cq_ring_size_);
+  }
+  sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                  IORING_OFF_SQ_RING);
+  cq_ring_ = single ? sq_ring_
+                    : mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                           IORING_OFF_CQ_RING);
+  sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  sqes_ = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (sq_ring_ == MAP_FAILED || cq_ring_ == MAP_FAILED || sqes_ == MAP_FAILED) {
+    if (sqes_ != MAP_FAILED) munmap(sqes_, sqes_size_);
+    if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) munmap(cq_ring_, cq_ring_size_);
+    if (sq_ring_ != MAP_FAILED) munmap(sq_ring_, sq_ring_size_);
+    close(fd);
+    return false;
+  }
+
+  auto sq = (char *)sq_ring_, cq = (char *)cq_ring_;
+  sq_tail_ = (unsigned *)(sq + params.sq_off.tail);
+  sq_mask_ = (unsigned *)(sq + params.sq_off.ring_mask);
+  sq_array_ = (unsigned *)(sq + params.sq_off.array);
+  cq_head_ = (unsigned *)(cq + params.cq_off.head);
+  cq_tail_ = (unsigned *)(cq + params.cq_off.tail);
+  cq_mask_ = (unsigned *)(cq + params.cq_off.ring_mask);
+  cqes_ = cq + params.cq_off.cqes;
+  ring_fd_ = fd;
+  slots_.resize(depth_);
+  for (auto i = depth_ - 1; i >= 0; i--) {
+    free_slots_.push_back(i);
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+void AsyncWriter::queue_write(int slot)
+{
+#ifdef HAVE_IO_URING
+  auto &request = slots_[slot];
+  // We are the only producer, so the tail needs no atomic read-modify-write;
+  // the release store publishes the entry to the kernel at the next flush().
+  auto tail = *sq_tail_;
+  auto index = tail & *sq_mask_;
+  auto sqe = (io_uring_sqe *)sqes_ + index;
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = IORING_OP_WRITE;
+  sqe->fd = request.fd;
+  sqe->addr = (unsigned long long)(request.data.data() + request.offset);
+  sqe->len = unsigned(request.data.size() - request.offset);
+  sqe->off = request.offset;
+  sqe->user_data = slot;
+  sq_array_[index] = index;
+  __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+  unsubmitted_++;
+#endif
+}
+
+// Hands the queued entries to the kernel. EAGAIN (no memory for requests
+// right now) and EBUSY (completion queue full) are transient: reap what has
+// finished and try again. Anything else fails the unsubmitted requests.
+void AsyncWriter::flush()
+{
+#ifdef HAVE_IO_URING
+  while (unsubmitted_ > 0) {
+    auto submitted = io_uring_enter(ring_fd_, unsubmitted_, 0, 0);
+    if (submitted >= 0) {
+      unsubmitted_ -= min(unsigned(submitted), unsubmitted_);
+      continue;
+    }
+    if (errno == EINTR) continue;
+    if (errno == EAGAIN || errno == EBUSY) {
+      // Wait only if the kernel holds something that can complete.
+      if (unsigned(inflight_) > unsubmitted_) {
+        reap(true);
+      } else {
+        this_thread::yield();
+      }
+      continue;
+    }
+    cerr << "can't queue writes: " << strerror(errno) << "\n";
+    // The kernel has not read these entries, so take them back off the ring.
+    auto tail = *sq_tail_;
+    for (; unsubmitted_ > 0; unsubmitted_--) {
+      tail--;
+      auto slot = int(((io_uring_sqe *)sqes_)[tail & *sq_mask_].user_data);
+      finish(slots_[slot], false);
+      free_slots_.push_back(slot);
+    }
+    __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+  }
+#endif
+}
+
+void AsyncWriter::reap(bool wait)
+{
+#ifdef HAVE_IO_URING
+  if (wait) {
+    while (io_uring_enter(ring_fd_, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno == EINTR) {
+    }
+  }
+  auto head = *cq_head_;
+  auto tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+  for (; head != tail; head++) {
+    auto cqe = (io_uring_cqe *)cqes_ + (head & *cq_mask_);
+    auto slot = int(cqe->user_data);
+    auto &request = slots_[slot];
+    if (cqe->res < 0) {
+      cerr << "can't write file " << request.filename << ": " << strerror(-cqe->res) << "\n";
+      finish(request, false);
+      free_slots_.push_back(slot);
+      continue;
+    }
+    request.offset += cqe->res;
+    if (cqe->res > 0 && request.offset < request.data.size()) {
+      queue_write(slot); // short write: send the rest
+      continue;
+    }
+    finish(request, request.offset == request.data.size());
+    free_slots_.push_back(slot);
+  }
+  __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+  flush();
+#endif
+}
+
+void AsyncWriter::finish(Request &request, bool ok)
+{
+  if (request.fd >= 0 && close(request.fd) != 0) ok = false;
+  request.fd = -1;
+  if (ok) {
+    bytes_ += request.data.size();
+  } else {
+    failures_++;
+  }
+  request.data = vector<unsigned char>();
+  if (--inflight_ == 0) {
+    busy_seconds_ += chrono::duration<double>(chrono::steady_clock::now() - busy_since_).count();
+  }
+}
+
+void AsyncWriter::run_thread()
+{
+  unique_lock<mutex> lock(mutex_);
+  for (;;) {
+    changed_.wait(lock, [&] { return closing_ || !queue_.empty(); });
+    if (queue_.empty()) return;
+    auto request = move(queue_.front());
+    queue_.pop_front();
+    lock.unlock();
+
+    auto ok = false;
+    request.fd = open_for_write(request.filename);
+    if (request.fd < 0) {
+      cerr << "can't open file " << request.filename << "\n";
+    } else {
+      ok = true;
+      while (request.offset < request.data.size()) {
+        auto n = write(request.fd, request.data.data() + request.offset, request.data.size() - request.offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+          cerr << "can't write file " << request.filename << "\n";
+          ok = false;
+          break;
+        }
+        request.offset += n;
+      }
+    }
+
+    lock.lock();
+    finish(request, ok);
+    changed_.notify_all();
+  }
+}
+
+bool AsyncWriter::submit(const string &filename, vector<unsigned char> data)
+{
+  if (ring_fd_ < 0) {
+    unique_lock<mutex> lock(mutex_);
+    changed_.wait(lock, [&] { return inflight_ < depth_; });
+    if (inflight_++ == 0) busy_since_ = chrono::steady_clock::now();
+    queue_.push_back(Request{filename, move(data), -1, 0});
+    changed_.notify_all();
+    return true;
+  }
+
+  while (inflight_ >= depth_) {
+    reap(true);
+  }
+  auto fd = open_for_write(filename);
+  if (fd < 0) {
+    cerr << "can't open file " << filename << "\n";
+    failures_++;
+    return false;
+  }
+  auto slot = free_slots_.back();
+  free_slots_.pop_back();
+  slots_[slot] = Request{filename, move(data), fd, 0};
+  if (inflight_++ == 0) busy_since_ = chrono::steady_clock::now();
+  queue_write(slot);
+  flush();
+  reap(false);
+  return true;
+}
+
+void AsyncWriter::drain()
+{
+  if (ring_fd_ < 0) {
+    unique_lock<mutex> lock(mutex_);
+    changed_.wait(lock, [&] { return inflight_ == 0; });
+    return;
+  }
+  while (inflight_ > 0) {
+    reap(true);
+  }
+}
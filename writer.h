@@ -0,0 +1,77 @@
+#ifndef __WRITER_H__
+#define __WRITER_H__
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Writes whole files in the background so the caller can move on to the
+// next frame. Uses io_uring when the kernel allows it and supports
+// IORING_OP_WRITE (5.6 on), and otherwise a dedicated I/O thread doing
+// plain write()s. At most `depth` files are in
+// flight; submit() blocks beyond that, which is what pushes back on the
+// stages feeding it. Not thread-safe: one thread submits.
+class AsyncWriter {
+private:
+	struct Request {
+		string filename;
+		vector<unsigned char> data;
+		int fd;
+		size_t offset;
+	};
+
+	int depth_;
+	int inflight_;
+	int failures_;
+	size_t bytes_;
+	chrono::steady_clock::time_point busy_since_;
+	double busy_seconds_;
+
+	// io_uring state; ring_fd_ < 0 when running on the fallback thread.
+	int ring_fd_;
+	void *sq_ring_, *cq_ring_, *sqes_;
+	size_t sq_ring_size_, cq_ring_size_, sqes_size_;
+	unsigned *sq_tail_, *sq_mask_, *sq_array_;
+	unsigned *cq_head_, *cq_tail_, *cq_mask_;
+	void *cqes_;
+	unsigned unsubmitted_; // entries queued in the ring but not yet taken by the kernel
+	vector<Request> slots_;
+	vector<int> free_slots_;
+
+	// Fallback thread state.
+	thread thread_;
+	mutex mutex_;
+	condition_variable changed_;
+	deque<Request> queue_;
+	bool closing_;
+
+	bool setup_ring();
+	void queue_write(int slot);
+	void flush();
+	void reap(bool wait);
+	void finish(Request &request, bool ok);
+	void run_thread();
+public:
+	AsyncWriter(int depth = 8, bool use_io_uring = true);
+	~AsyncWriter();
+
+	// Takes ownership of the bytes. Returns false if the file could not be
+	// opened (io_uring) or was not queued; write errors show up in failures().
+	bool submit(const string &filename, vector<unsigned char> data);
+	// Blocks until every submitted file is written and closed.
+	void drain();
+
+	bool uses_io_uring() const { return ring_fd_ >= 0; }
+	int failures() const { return failures_; }
+	size_t bytes_written() const { return bytes_; }
+	// Wall time with at least one write outstanding, as seen by this object.
+	double busy_seconds() const { return busy_seconds_; }
+};
+
+#endif //__WRITER_H__